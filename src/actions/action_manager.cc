@@ -1,6 +1,7 @@
 
 # include <iostream>
 # include <vector>
+# include <algorithm>
 
 # include "astroid.hh"
 # include "action_manager.hh"
@@ -35,6 +36,36 @@ namespace Astroid {
 
       while (!actions.empty ()) {
         refptr<Action> a = actions.front ();
+
+        if (a->need_db && a->need_db_rw) {
+          /* drain all consecutive read-write actions into one batch that
+           * is run in a single read-write session */
+          std::vector<refptr<Action>> batch;
+
+          while (!actions.empty () &&
+                 actions.front ()->need_db &&
+                 actions.front ()->need_db_rw) {
+            batch.push_back (actions.front ());
+            actions.pop_front ();
+          }
+
+          /* allow new actions to be queued while waiting for db */
+          lk.unlock ();
+
+          Db db (Db::DbMode::DATABASE_READ_WRITE);
+
+          lk.lock ();
+
+          run_batch (&db, batch);
+          db.close ();
+
+          for (auto &ba : batch) {
+            done (ba);
+          }
+
+          continue;
+        }
+
         actions.pop_front ();
 
         /* allow new actions to be queued while waiting for db */
@@ -44,13 +75,8 @@ namespace Astroid {
         std::unique_lock<std::mutex> rw_lock;
 
         if (a->need_db) {
-          if (a->need_db_rw) {
-            db = new Db (Db::DbMode::DATABASE_READ_WRITE);
+          db = new Db (Db::DbMode::DATABASE_READ_ONLY);
 
-          } else {
-            db = new Db (Db::DbMode::DATABASE_READ_ONLY);
-
-          }
         } else {
           if (a->need_db_rw) {
             rw_lock = Db::acquire_rw_lock ();
@@ -80,11 +106,7 @@ namespace Astroid {
           }
         }
 
-        if (!a->in_undo && a->undoable () && !a->skip_undo) {
-          doneactions.push_back (a);
-        }
-
-        if (emit) toemit.push (a);
+        done (a);
       }
 
       lk.unlock ();
@@ -93,6 +115,39 @@ namespace Astroid {
     }
   }
 
+  void ActionManager::run_batch (Db * db, std::vector<refptr<Action>> &batch) {
+    log << debug << "actions: running batch of " << batch.size () << " actions." << endl;
+
+    notmuch_status_t s = notmuch_database_begin_atomic (db->nm_db);
+    if (s != NOTMUCH_STATUS_SUCCESS) {
+      log << error << "actions: could not begin atomic section: " << s << endl;
+    }
+
+    for (auto &a : batch) {
+      if (!a->in_undo) {
+        a->doit (db);
+      } else {
+        a->undo (db);
+      }
+    }
+
+    if (s == NOTMUCH_STATUS_SUCCESS) {
+      s = notmuch_database_end_atomic (db->nm_db);
+      if (s != NOTMUCH_STATUS_SUCCESS) {
+        log << error << "actions: could not end atomic section: " << s << endl;
+      }
+    }
+  }
+
+  void ActionManager::done (refptr<Action> a) {
+    /* must be called with actions_m held */
+    if (!a->in_undo && a->undoable () && !a->skip_undo) {
+      doneactions.push_back (a);
+    }
+
+    if (emit) toemit.push (a);
+  }
+
   void ActionManager::undo () {
     log << info << "actions: undo" << endl;
     std::unique_lock<std::mutex> lk (actions_m);
@@ -162,6 +217,7 @@ namespace Astroid {
   void ActionManager::close () {
     log << debug << "actions: cleaning up remaining actions.." << endl;
     emit = false;
+    changed_threads_timeout.disconnect ();
 
     std::unique_lock<std::mutex> lk (actions_m);
 
@@ -195,6 +251,38 @@ namespace Astroid {
   void ActionManager::emit_thread_changed (Db * db, ustring thread_id) {
     log << info << "actions: emitted changed signal for thread: " << thread_id << endl;
     m_signal_thread_changed.emit (db, thread_id);
+
+    /* queue for batched signal */
+    if (find (changed_threads.begin (), changed_threads.end (), thread_id) == changed_threads.end ()) {
+      changed_threads.push_back (thread_id);
+    }
+
+    if (!changed_threads_timeout.connected ()) {
+      changed_threads_timeout = Glib::signal_timeout ().connect (
+          sigc::mem_fun (this, &ActionManager::on_changed_threads_timeout),
+          changed_threads_window);
+    }
+  }
+
+  bool ActionManager::on_changed_threads_timeout () {
+    /* runs on gui thread */
+    std::vector<ustring> thread_ids;
+    swap (thread_ids, changed_threads);
+
+    if (emit && !thread_ids.empty ()) {
+      log << info << "actions: emitted changed signal for " << thread_ids.size () << " threads." << endl;
+
+      Db db (Db::DATABASE_READ_ONLY);
+      m_signal_threads_changed.emit (&db, thread_ids);
+    }
+
+    return false;
+  }
+
+  ActionManager::type_signal_threads_changed
+    ActionManager::signal_threads_changed ()
+  {
+    return m_signal_threads_changed;
   }
 
   /* message */
@@ -234,5 +322,16 @@ namespace Astroid {
     log << info << "actions: emitted refreshed signal." << endl;
     m_signal_refreshed.emit ();
   }
-}
 
+  /* refreshed lastmod */
+  ActionManager::type_signal_refreshed_lastmod
+    ActionManager::signal_refreshed_lastmod ()
+  {
+    return m_signal_refreshed_lastmod;
+  }
+
+  void ActionManager::emit_refreshed_lastmod (Db * db, unsigned long from, unsigned long to) {
+    log << info << "actions: emitted refreshed lastmod signal: " << from << ".." << to << endl;
+    m_signal_refreshed_lastmod.emit (db, from, to);
+  }
+}
@@ -26,6 +26,10 @@ namespace Astroid {
       std::thread action_worker_t;
       void action_worker ();
 
+      /* run a batch of read-write actions in one atomic db session */
+      void run_batch (Db *, std::vector<refptr<Action>> &);
+      void done (refptr<Action>);
+
       std::mutex actions_m;
       std::condition_variable actions_cv;
 
@@ -41,6 +45,13 @@ namespace Astroid {
       /* used when closing: do not emit signals when closing */
       bool emit = true;
 
+      /* pending threads for signal_threads_changed */
+      std::vector<ustring> changed_threads;
+      sigc::connection     changed_threads_timeout;
+      bool on_changed_threads_timeout ();
+
+      const int changed_threads_window = 50; // ms
+
     public:
 
       /* thread updated: called from e.g. thread-index and poll, but
@@ -59,6 +70,11 @@ namespace Astroid {
 
       void emit_thread_changed (Db *, ustring);
 
+      /* threads changed: thread_changed signals coalesced over a short
+       * window, emitted once with all the thread ids that changed. */
+      typedef sigc::signal <void, Db *, std::vector<ustring>> type_signal_threads_changed;
+      type_signal_threads_changed signal_threads_changed ();
+
       /* message update signal */
       typedef sigc::signal <void, Db *, ustring> type_signal_message_updated;
       type_signal_message_updated signal_message_updated ();
@@ -73,11 +89,21 @@ namespace Astroid {
 
       Glib::Dispatcher signal_refreshed_dispatcher;
 
+      /* refreshed lastmod signal (after polling): all threads with
+       * messages modified in the revision range (lastmod:from..to) may
+       * have changed. */
+      typedef sigc::signal <void, Db *, unsigned long, unsigned long> type_signal_refreshed_lastmod;
+      type_signal_refreshed_lastmod signal_refreshed_lastmod ();
+
+      void emit_refreshed_lastmod (Db *, unsigned long, unsigned long);
+
     protected:
       type_signal_thread_updated m_signal_thread_updated;
       type_signal_thread_changed m_signal_thread_changed;
+      type_signal_threads_changed m_signal_threads_changed;
       type_signal_message_updated m_signal_message_updated;
       type_signal_refreshed m_signal_refreshed;
+      type_signal_refreshed_lastmod m_signal_refreshed_lastmod;
 
   };
 }
@@ -1,5 +1,6 @@
 # include <iostream>
 # include <vector>
+# include <algorithm>
 
 # include "action.hh"
 # include "db.hh"
@@ -42,6 +43,16 @@ namespace Astroid {
   }
 
   bool TagAction::doit (Db * db) {
+    /* use the bulk tagging path when only threads are tagged */
+    bool all_threads = all_of (taggables.begin (), taggables.end (),
+        [&] (refptr<NotmuchTaggable> &t) {
+          return bool(refptr<NotmuchThread>::cast_dynamic (t));
+        });
+
+    if (all_threads && taggables.size () > 1) {
+      return doit_threads (db);
+    }
+
     bool res = true;
     for (auto &tagged : taggables) {
       log << info << "tag_action: " << tagged->str () << ", add: ";
@@ -77,6 +88,82 @@ namespace Astroid {
     return res;
   }
 
+  bool TagAction::doit_threads (Db * db) {
+    log << info << "tag_action: " << taggables.size () << " threads, add: ";
+    for (auto &t : add) log << t << ", ";
+    log << "remove: ";
+    for (auto &t : remove) log << t << ", ";
+    log << endl;
+
+    /* like add_tag and remove_tag: only threads that do not have a tag to
+     * add, or that have a tag to remove, are touched. the return value is
+     * false if any thread already had a tag to add, or did not have a tag
+     * to remove. */
+    bool res = true;
+
+    for (ustring t : add) {
+      t = Db::sanitize_tag (t);
+
+      vector<refptr<NotmuchTaggable>> change;
+      for (auto &tagged : taggables) {
+        if (!tagged->has_tag (t)) change.push_back (tagged);
+        else res = false;
+      }
+
+      if (!tag_threads (db, change, { t }, {})) return false;
+
+      for (auto &tagged : change) {
+        tagged->tags.push_back (t);
+        sort (tagged->tags.begin (), tagged->tags.end ());
+      }
+    }
+
+    for (ustring t : remove) {
+      t = Db::sanitize_tag (t);
+
+      vector<refptr<NotmuchTaggable>> change;
+      for (auto &tagged : taggables) {
+        if (tagged->has_tag (t)) change.push_back (tagged);
+        else res = false;
+      }
+
+      if (!tag_threads (db, change, {}, { t })) return false;
+
+      for (auto &tagged : change) {
+        tagged->tags.erase (std::remove (tagged->tags.begin (),
+                                         tagged->tags.end (),
+                                         t), tagged->tags.end ());
+      }
+    }
+
+    for (auto &tagged : taggables) {
+      refptr<NotmuchThread>::cast_dynamic (tagged)->version = NotmuchThread::next_version ();
+    }
+
+    return res;
+  }
+
+  bool TagAction::tag_threads (
+      Db * db,
+      vector<refptr<NotmuchTaggable>> &threads,
+      vector<ustring> _add,
+      vector<ustring> _remove)
+  {
+    if (threads.empty ()) return true;
+
+    vector<ustring> thread_ids;
+    for (auto &tagged : threads) {
+      thread_ids.push_back (refptr<NotmuchThread>::cast_dynamic (tagged)->thread_id);
+    }
+
+    if (!db->tag_threads (thread_ids, _add, _remove)) {
+      log << error << "tag_action: bulk tagging failed." << endl;
+      return false;
+    }
+
+    return true;
+  }
+
   bool TagAction::undo (Db * db) {
     log << info << "tag_action: undo." << endl;
 
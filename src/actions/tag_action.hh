@@ -31,6 +31,14 @@ namespace Astroid {
       virtual bool undoable () override;
       virtual void emit (Db *) override;
 
+    protected:
+      /* tag all taggables (which must be threads) in one bulk operation */
+      bool doit_threads (Db *);
+      bool tag_threads (Db *,
+          std::vector<refptr<NotmuchTaggable>> &,
+          std::vector<ustring>,
+          std::vector<ustring>);
+
   };
 
 }
@@ -25,6 +25,11 @@
 
 # include "log.hh"
 # include "poll.hh"
+# include "thread_cache.hh"
+# include "crypto.hh"
+# include "thumbnail_cache.hh"
+# include "message_cache.hh"
+# include "modes/thread_view/web_view_pool.hh"
 
 /* UI */
 # include "main_window.hh"
@@ -250,6 +255,7 @@ namespace Astroid {
     Date::init ();
     Utils::init ();
     Db::init ();
+    Crypto::init ();
     Keybindings::init ();
     SavedSearches::init ();
 
@@ -267,6 +273,23 @@ namespace Astroid {
     /* set up global actions */
     actions = new ActionManager ();
 
+    /* set up thread summary cache */
+    thread_cache = new ThreadCache ();
+
+    /* set up thumbnail cache */
+    thumbnail_cache = new ThumbnailCache (
+        standard_paths ().cache_dir / bfs::path ("thumbnails"),
+        config ("thread_view").get<uintmax_t> ("thumbnail_cache_size") * 1024 * 1024);
+
+    /* set up parsed message cache */
+    message_cache = new MessageCache (
+        config ("thread_view").get<size_t> ("message_cache_size") * 1024 * 1024,
+        config ("thread_view").get<size_t> ("message_cache_count"));
+
+    /* set up web views for the thread views */
+    web_view_pool = new WebViewPool (
+        config ("thread_view").get<unsigned int> ("web_view_pool_size"));
+
     /* set up poller */
     poll = new Poll (!no_auto_poll);
 
@@ -276,6 +299,10 @@ namespace Astroid {
     } else {
       open_new_window ();
     }
+
+    /* load the web views for the thread views when idle */
+    web_view_pool->warm ();
+
     app->run ();
 
     on_quit ();
@@ -302,6 +329,7 @@ namespace Astroid {
     Date::init ();
     Utils::init ();
     Db::init ();
+    Crypto::init ();
     SavedSearches::init ();
 
     /* set up accounts */
@@ -318,6 +346,23 @@ namespace Astroid {
     /* set up global actions */
     actions = new ActionManager ();
 
+    /* set up thread summary cache */
+    thread_cache = new ThreadCache ();
+
+    /* set up thumbnail cache */
+    thumbnail_cache = new ThumbnailCache (
+        standard_paths ().cache_dir / bfs::path ("thumbnails"),
+        config ("thread_view").get<uintmax_t> ("thumbnail_cache_size") * 1024 * 1024);
+
+    /* set up parsed message cache */
+    message_cache = new MessageCache (
+        config ("thread_view").get<size_t> ("message_cache_size") * 1024 * 1024,
+        config ("thread_view").get<size_t> ("message_cache_count"));
+
+    /* set up web views for the thread views */
+    web_view_pool = new WebViewPool (
+        config ("thread_view").get<unsigned int> ("web_view_pool_size"));
+
     /* set up poller */
     poll = new Poll (false);
   }
@@ -332,6 +377,10 @@ namespace Astroid {
     /* clean up and exit */
     if (actions) actions->close ();
     SavedSearches::destruct ();
+    if (message_cache) message_cache->clear ();
+    Crypto::destruct ();
+
+    if (thread_cache) thread_cache->save ();
 
 # ifndef DISABLE_PLUGINS
     if (plugin_manager) delete plugin_manager;
@@ -350,6 +399,10 @@ namespace Astroid {
     delete accounts;
     delete m_config;
     delete poll;
+    delete thread_cache;
+    delete thumbnail_cache;
+    delete message_cache;
+    delete web_view_pool;
 
     if (actions) actions->close ();
     delete actions;
@@ -45,6 +45,18 @@ namespace Astroid {
       /* poll */
       Poll * poll;
 
+      /* persistent thread summaries */
+      ThreadCache * thread_cache = NULL;
+
+      /* persistent attachment thumbnails */
+      ThumbnailCache * thumbnail_cache = NULL;
+
+      /* parsed messages */
+      MessageCache * message_cache = NULL;
+
+      /* web views for the thread views */
+      WebViewPool * web_view_pool = NULL;
+
       MainWindow * open_new_window (bool open_defaults = true);
 
     protected:
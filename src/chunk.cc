@@ -429,14 +429,48 @@ namespace Astroid {
   }
 
   size_t Chunk::get_file_size () {
+    /* the decoded size, estimated from the length of the encoded content
+     * when possible so that the content does not need to be decoded. */
+    if (GMIME_IS_PART (mime_object)) {
+      GMimeDataWrapper * content = g_mime_part_get_content_object (GMIME_PART (mime_object));
+      GMimeStream * stream = g_mime_data_wrapper_get_stream (content);
+
+      gint64 len = g_mime_stream_length (stream);
+
+      if (len >= 0) {
+        switch (g_mime_data_wrapper_get_encoding (content)) {
+          case GMIME_CONTENT_ENCODING_BASE64:
+            /* 3 bytes per 4 characters, in lines of 76 characters */
+            return static_cast<size_t> ((len - len / 77) / 4 * 3);
+
+          case GMIME_CONTENT_ENCODING_DEFAULT:
+          case GMIME_CONTENT_ENCODING_7BIT:
+          case GMIME_CONTENT_ENCODING_8BIT:
+          case GMIME_CONTENT_ENCODING_BINARY:
+            return static_cast<size_t> (len);
+
+          default:
+            break;
+        }
+      }
+    }
+
+    /* count the decoded bytes without keeping them */
     time_t t0 = clock ();
 
-    // https://github.com/skx/lumail/blob/master/util/attachments.c
+    GMimeStream * null = g_mime_stream_null_new ();
+
+    if (GMIME_IS_PART (mime_object)) {
+      GMimeDataWrapper * content = g_mime_part_get_content_object (GMIME_PART (mime_object));
+      g_mime_data_wrapper_write_to_stream (content, null);
+    } else {
+      g_mime_object_write_to_stream (mime_object, null);
+    }
 
-    refptr<Glib::ByteArray> cnt = contents ();
-    size_t sz = cnt->size ();
+    size_t sz = GMIME_STREAM_NULL (null)->written;
+    g_object_unref (null);
 
-    log << info << "chunk: file size: " << sz << " (time used to calculate: " << ( (clock () - t0) * 1000.0 / CLOCKS_PER_SEC ) << " s.)" << std::endl;
+    log << debug << "chunk: file size: " << sz << " (time used to calculate: " << ( (clock () - t0) * 1000.0 / CLOCKS_PER_SEC ) << " s.)" << std::endl;
 
     return sz;
   }
@@ -475,6 +509,54 @@ namespace Astroid {
     return data;
   }
 
+  GMimeStream * Chunk::decoded_stream () {
+    GMimeStream * mem = g_mime_stream_mem_new ();
+
+    if (!GMIME_IS_PART (mime_object)) {
+      g_mime_object_write_to_stream (mime_object, mem);
+      g_mime_stream_reset (mem);
+      return mem;
+    }
+
+    GMimeDataWrapper * content = g_mime_part_get_content_object (GMIME_PART (mime_object));
+    GMimeStream * stream = g_mime_data_wrapper_get_stream (content);
+    GMimeStream * raw;
+
+    if (GMIME_IS_STREAM_MEM (stream) || GMIME_IS_STREAM_MMAP (stream)) {
+      /* a new stream over the same bytes (usually the mapped message
+       * file): it has its own position, so it may be read on another
+       * thread while the part is used on this one. nothing is copied. */
+      g_object_unref (mem);
+      raw = g_mime_stream_substream (stream, stream->bound_start, stream->bound_end);
+    } else {
+      /* other streams share their position (e.g. the file offset) with
+       * the parser and must only be used on this thread: copy */
+      g_mime_stream_reset (stream);
+      g_mime_stream_write_to_stream (stream, mem);
+      g_mime_stream_reset (stream);
+      raw = mem;
+    }
+
+    g_mime_stream_reset (raw);
+
+    GMimeContentEncoding enc = g_mime_data_wrapper_get_encoding (content);
+
+    if (enc != GMIME_CONTENT_ENCODING_BASE64 &&
+        enc != GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE &&
+        enc != GMIME_CONTENT_ENCODING_UUENCODE) {
+      return raw;
+    }
+
+    GMimeStream * filtered = g_mime_stream_filter_new (raw);
+    GMimeFilter * filter   = g_mime_filter_basic_new (enc, false);
+    g_mime_stream_filter_add (GMIME_STREAM_FILTER (filtered), filter);
+
+    g_object_unref (filter);
+    g_object_unref (raw);
+
+    return filtered;
+  }
+
   bool Chunk::save_to (std::string filename, bool overwrite) {
     /* saves chunk to file name, if filename is dir, own name */
     using std::endl;
@@ -61,6 +61,12 @@ namespace Astroid {
       size_t  get_file_size ();
       refptr<Glib::ByteArray> contents ();
 
+      /* a stream decoding the encoded content, it may be read on another
+       * thread. it reads the bytes of the message source directly when
+       * possible, otherwise from a private copy. the caller owns the
+       * stream. */
+      GMimeStream * decoded_stream ();
+
       bool save_to (std::string filename, bool overwrite = false);
       void open ();
       void save ();
@@ -125,14 +125,14 @@ namespace Astroid {
     }
     set_from (from);
 
-    char * cto = internet_address_list_to_string (msg.to(), false);
-    if (cto) set_to (cto);
+    AddressList ato = msg.to ();
+    if (ato.size () > 0) set_to (ato.str ());
 
-    cto = internet_address_list_to_string (msg.cc(), false);
-    if (cto) set_cc (cto);
+    AddressList acc = msg.cc ();
+    if (acc.size () > 0) set_cc (acc.str ());
 
-    cto = internet_address_list_to_string (msg.bcc(), false);
-    if (cto) set_bcc (cto);
+    AddressList abcc = msg.bcc ();
+    if (abcc.size () > 0) set_bcc (abcc.str ());
 
     set_references (msg.references);
     set_inreplyto (msg.inreplyto);
@@ -153,6 +153,27 @@ namespace Astroid {
     default_config.put ("thread_index.sort_order", "newest");
     default_config.put ("thread_index.thread_load_step", 250);
 
+    /* number of threads in each thread index that keep their subject and
+     * authors in memory, other threads load them when displayed. */
+    default_config.put ("thread_index.cached_threads", 1000);
+
+    /* number of threads used to load the thread index, each with its own
+     * read-only database. 1 loads serially. */
+    default_config.put ("thread_index.loader_threads", 1);
+
+    /* keep a persistent cache of thread summaries in the cache dir, it is
+     * kept up to date using lastmod (requires notmuch with lastmod). */
+    default_config.put ("thread_index.summary_cache", true);
+
+    /* parse the messages of the selected thread and its neighbours in the
+     * background when the cursor has not moved for delay ms. at most
+     * budget MB of message files are parsed each time, requires the
+     * message cache (thread_view.message_cache_size). */
+    default_config.put ("thread_index.prefetch.enable", true);
+    default_config.put ("thread_index.prefetch.delay", 50);
+    default_config.put ("thread_index.prefetch.neighbours", 2);
+    default_config.put ("thread_index.prefetch.budget", 20);
+
     default_config.put ("general.time.clock_format", "local"); // or 24h, 12h
     default_config.put ("general.time.same_year", "%b %-e");
     default_config.put ("general.time.diff_year", "%x");
@@ -209,6 +230,11 @@ namespace Astroid {
 
     default_config.put ("thread_view.indent_messages", false);
 
+    /* insert each message as a single html string, set to false to fill
+     * in the template element by element (slower). a custom
+     * thread-view.html is always filled in element by element. */
+    default_config.put ("thread_view.batch_render", true);
+
     /* mathjax */
     default_config.put ("thread_view.mathjax.enable", true);
 
@@ -233,10 +259,36 @@ namespace Astroid {
     /* gravatar */
     default_config.put ("thread_view.gravatar.enable", true);
 
+    /* maximum size of the attachment thumbnail cache in MB, 0 disables
+     * the cache */
+    default_config.put ("thread_view.thumbnail_cache_size", 50);
+
+    /* maximum (estimated) size of parsed messages kept in memory in MB, 0
+     * disables the cache */
+    default_config.put ("thread_view.message_cache_size", 100);
+
+    /* maximum number of parsed messages kept in memory, each holds its
+     * message file in memory */
+    default_config.put ("thread_view.message_cache_count", 2000);
+
+    /* number of web views with the thread view loaded that are kept ready
+     * for new thread views, 0 creates them when needed */
+    default_config.put ("thread_view.web_view_pool_size", 2);
+
     /* crypto */
     default_config.put ("crypto.gpg.path", "gpg2");
     default_config.put ("crypto.gpg.always_trust", true);
 
+    /* decrypted parts are kept in locked memory (not swapped out) so that
+     * re-opening an encrypted message does not need gpg. size is in MB
+     * (0 disables the cache), entries expire after ttl seconds. */
+    default_config.put ("crypto.decrypted_cache.size", 10);
+    default_config.put ("crypto.decrypted_cache.ttl", 600);
+
+    /* signature verifications are re-used for ttl seconds, or until the
+     * keyring or trust db changes (0 verifies every time). */
+    default_config.put ("crypto.verified_cache.ttl", 3600);
+
     /* saved searches */
     default_config.put ("saved_searches.show_on_startup", false);
     default_config.put ("saved_searches.save_history", true);
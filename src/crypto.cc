@@ -2,6 +2,13 @@
 # include <gmime/gmime.h>
 
 # include <string>
+# include <cstring>
+# include <ctime>
+# include <algorithm>
+
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
 
 # include <boost/algorithm/string.hpp>
 
@@ -14,21 +21,87 @@
 using std::endl;
 
 namespace Astroid {
-  Crypto::Crypto (ustring _protocol) {
-    using std::endl;
-    config = astroid->config ("crypto");
-    gpgpath = ustring (config.get<std::string> ("gpg.path"));
-    always_trust = config.get<bool> ("gpg.always_trust");
+  std::mutex Crypto::pool_m;
+  std::vector<GMimeCryptoContext *> Crypto::pool;
+  ustring Crypto::gpgpath;
+  bool    Crypto::always_trust = false;
+
+  std::mutex Crypto::verified_m;
+  std::map<std::string, Crypto::VerifiedPart> Crypto::verified_cache;
+  time_t Crypto::verified_keyring = 0;
+  int    Crypto::verified_ttl     = 0;
+
+  std::mutex Crypto::decrypted_m;
+  std::map<std::string, Crypto::DecryptedPart> Crypto::decrypted_cache;
+  size_t Crypto::decrypted_size = 0;
+  size_t Crypto::decrypted_max  = 0;
+  int    Crypto::decrypted_ttl  = 0;
+
+  extern "C" void Crypto_on_screensaver_active (GObject * app, GParamSpec *, gpointer) {
+    gboolean active = FALSE;
+    g_object_get (app, "screensaver-active", &active, NULL);
+
+    if (active) {
+      log << info << "crypto: screen locked, wiping decrypted parts." << endl;
+      Crypto::wipe_decrypted ();
+    }
+  }
+
+  void Crypto::init () {
+    ptree config = astroid->config ("crypto");
+
+    if (!astroid->in_test ()) {
+      gpgpath = ustring (config.get<std::string> ("gpg.path"));
+      always_trust = config.get<bool> ("gpg.always_trust");
+    } else {
+      gpgpath = "gpg";
+      always_trust = true;
+    }
 
     log << debug << "crypto: gpg: " << gpgpath << endl;
 
+    decrypted_max = config.get<size_t> ("decrypted_cache.size") * 1024 * 1024;
+    decrypted_ttl = config.get<int> ("decrypted_cache.ttl");
+
+    verified_ttl  = config.get<int> ("verified_cache.ttl");
+
+    if (decrypted_max > 0 && decrypted_ttl > 0) {
+      Glib::signal_timeout ().connect_seconds (
+          sigc::ptr_fun (&Crypto::on_expire_timeout), 60);
+    }
+
+    /* wipe decrypted parts when the screen is locked (gtk >= 3.24) */
+    if (astroid->app &&
+        g_object_class_find_property (G_OBJECT_GET_CLASS (astroid->app->gobj ()),
+          "screensaver-active") != NULL) {
+
+      g_signal_connect (astroid->app->gobj (), "notify::screensaver-active",
+          G_CALLBACK (Crypto_on_screensaver_active), NULL);
+    }
+  }
+
+  void Crypto::destruct () {
+    std::unique_lock<std::mutex> lk (pool_m);
+    for (auto ctx : pool) g_object_unref (ctx);
+    pool.clear ();
+    lk.unlock ();
+
+    std::unique_lock<std::mutex> vlk (verified_m);
+    clear_verified ();
+    vlk.unlock ();
+
+    wipe_decrypted ();
+  }
+
+  Crypto::Crypto (ustring _protocol) {
+    using std::endl;
+
     protocol = _protocol.lowercase ();
 
     if ((protocol == "application/pgp-encrypted" ||
         protocol == "application/pgp-signature")) {
 
       isgpg = true;
-      create_gpg_context ();
 
     } else {
       log << error << "crypto: unsupported protocol: " << protocol << endl;
@@ -42,6 +115,9 @@ namespace Astroid {
 
   Crypto::~Crypto () {
     log << debug << "crypto: deconstruct." << endl;
+
+    if (slist_owned) g_object_unref (slist);
+    if (decrypt_res) g_object_unref (decrypt_res);
   }
 
   GMimeObject * Crypto::decrypt_and_verify (GMimeObject * part) {
@@ -56,9 +132,34 @@ namespace Astroid {
 
     GError *err = NULL;
 
-    GMimeMultipartEncrypted * ep = GMIME_MULTIPART_ENCRYPTED (part);
-    GMimeObject * dp = g_mime_multipart_encrypted_decrypt
-	(ep, gpgctx, &decrypt_res, &err);
+    std::string digest;
+    GMimeObject * dp = NULL;
+
+    if (decrypted_max > 0) {
+      digest = get_part_digest (part);
+      dp = load_decrypted (digest, &decrypt_res);
+    }
+
+    if (dp != NULL) {
+      log << debug << "crypto: using cached decrypted part." << endl;
+
+    } else {
+      GMimeCryptoContext * gpgctx = acquire_context ();
+      if (gpgctx == NULL) {
+        decrypt_error = "Could not create gpg context.";
+        return NULL;
+      }
+
+      GMimeMultipartEncrypted * ep = GMIME_MULTIPART_ENCRYPTED (part);
+      dp = g_mime_multipart_encrypted_decrypt
+        (ep, gpgctx, &decrypt_res, &err);
+
+      release_context (gpgctx);
+
+      if (dp != NULL && decrypted_max > 0) {
+        store_decrypted (digest, dp, decrypt_res);
+      }
+    }
 
     /* GMimeDecryptResult and GMimeCertificates
      *
@@ -127,13 +228,306 @@ namespace Astroid {
 
     verify_tried = true;
 
+    std::string digest = get_part_digest (mo);
+    time_t keyring  = keyring_mtime ();
+
+    std::unique_lock<std::mutex> vlk (verified_m);
+    if (keyring != verified_keyring) {
+      if (!verified_cache.empty ()) {
+        log << debug << "crypto: keyring changed, dropping cached signature verifications." << endl;
+      }
+
+      clear_verified ();
+      verified_keyring = keyring;
+    }
+
+    auto fnd = verified_cache.find (digest);
+    if (fnd != verified_cache.end () &&
+        (time (NULL) - fnd->second.added) > verified_ttl) {
+      g_object_unref (fnd->second.slist);
+      verified_cache.erase (fnd);
+      fnd = verified_cache.end ();
+    }
+
+    if (fnd != verified_cache.end ()) {
+      slist = fnd->second.slist;
+      g_object_ref (slist);
+      slist_owned = true;
+      vlk.unlock ();
+
+      log << debug << "crypto: using cached signature verification." << endl;
+
+      verified = verify_signature_list (slist);
+      return verified;
+    }
+    vlk.unlock ();
+
+    GMimeCryptoContext * gpgctx = acquire_context ();
+    if (gpgctx == NULL) return false;
+
     slist = g_mime_multipart_signed_verify (GMIME_MULTIPART_SIGNED(mo), gpgctx, &err);
+    slist_owned = (slist != NULL);
+
+    release_context (gpgctx);
 
     verified = verify_signature_list (slist);
 
+    if (slist != NULL) {
+      /* a missing public key may be imported later, try again next time */
+      bool missing_key = false;
+      for (int i = 0; i < g_mime_signature_list_length (slist); i++) {
+        GMimeSignature * s = g_mime_signature_list_get_signature (slist, i);
+        missing_key |= (g_mime_signature_get_errors (s) & GMIME_SIGNATURE_ERROR_NO_PUBKEY) != 0;
+      }
+
+      if (!missing_key && verified_ttl > 0) {
+        vlk.lock ();
+        if (verified_cache.size () >= MAX_VERIFIED) {
+          clear_verified ();
+        }
+
+        /* the keyring may have changed during verification */
+        if (keyring == verified_keyring &&
+            verified_cache.find (digest) == verified_cache.end ()) {
+          g_object_ref (slist);
+          verified_cache[digest] = { slist, time (NULL) };
+        }
+      }
+    }
+
     return verified;
   }
 
+  time_t Crypto::keyring_mtime () {
+    /* the newest modification of the public keyring or trust db */
+    bfs::path home;
+    char * gh = getenv ("GNUPGHOME");
+    if (gh != NULL) {
+      home = bfs::path (gh);
+    } else {
+      home = astroid->standard_paths ().home / bfs::path (".gnupg");
+    }
+
+    time_t mtime = 0;
+
+    for (const char * f : { "pubring.kbx", "pubring.gpg", "trustdb.gpg" }) {
+      struct stat st;
+      if (stat ((home / bfs::path (f)).c_str (), &st) == 0) {
+        mtime = std::max (mtime, st.st_mtime);
+      }
+    }
+
+    return mtime;
+  }
+
+  void Crypto::clear_verified () {
+    /* requires lock */
+    for (auto &v : verified_cache) g_object_unref (v.second.slist);
+    verified_cache.clear ();
+  }
+
+  /* decrypted parts {{{ */
+  void Crypto::wipe (void * p, size_t len) {
+    /* volatile so that the writes are not optimized away */
+    volatile unsigned char * v = static_cast<volatile unsigned char *> (p);
+    while (len--) *v++ = 0;
+  }
+
+  void Crypto::free_locked_pages (gpointer data) {
+    LockedPages * l = static_cast<LockedPages *> (data);
+
+    wipe (l->data, l->mapped);
+    munlock (l->data, l->mapped);
+    munmap (l->data, l->mapped);
+
+    /* the array does not own the pages */
+    g_byte_array_free (l->array, false);
+
+    delete l;
+  }
+
+  void Crypto::store_decrypted (std::string digest, GMimeObject * dp, GMimeDecryptResult * res) {
+    /* measure the serialized part first, so that it can be written
+     * directly to the locked memory without an intermediate copy */
+    GMimeStream * null = g_mime_stream_null_new ();
+    g_mime_object_write_to_stream (dp, null);
+
+    DecryptedPart d;
+    d.size  = GMIME_STREAM_NULL (null)->written;
+    d.res   = res;
+    d.added = time (NULL);
+
+    g_object_unref (null);
+
+    size_t page = sysconf (_SC_PAGESIZE);
+    d.mapped = ((d.size + page - 1) / page) * page;
+
+    if (d.size == 0 || d.mapped > decrypted_max) return;
+
+    void * p = mmap (NULL, d.mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED) {
+      log << error << "crypto: could not allocate memory for decrypted part." << endl;
+      return;
+    }
+
+    /* only keep the decrypted part if it can not be swapped out */
+    if (mlock (p, d.mapped) != 0) {
+      log << warn << "crypto: could not lock memory for decrypted part (RLIMIT_MEMLOCK?), not caching." << endl;
+      munmap (p, d.mapped);
+      return;
+    }
+
+# ifdef MADV_DONTDUMP
+    madvise (p, d.mapped, MADV_DONTDUMP);
+# endif
+
+    LockedPages * l = new LockedPages ();
+    l->data   = p;
+    l->mapped = d.mapped;
+    l->array  = g_byte_array_new_take (static_cast<guint8 *> (p), d.size);
+
+    /* the stream does not own the array and is bounded to it, so that
+     * writing never reallocates the locked memory */
+    d.stream = g_mime_stream_mem_new_with_byte_array (l->array);
+    g_mime_stream_mem_set_owner (GMIME_STREAM_MEM (d.stream), false);
+    g_mime_stream_set_bounds (d.stream, 0, d.size);
+    g_object_set_data_full (G_OBJECT (d.stream), "astroid-locked-pages", l, &free_locked_pages);
+
+    ssize_t written = g_mime_object_write_to_stream (dp, d.stream);
+    g_mime_stream_reset (d.stream);
+
+    if (written < 0 || static_cast<size_t> (written) != d.size) {
+      log << error << "crypto: could not serialize decrypted part." << endl;
+      g_object_unref (d.stream); // wipes and frees the pages
+      return;
+    }
+
+    if (d.res) g_object_ref (d.res);
+
+    std::lock_guard<std::mutex> lk (decrypted_m);
+
+    auto fnd = decrypted_cache.find (digest);
+    if (fnd != decrypted_cache.end ()) {
+      decrypted_size -= fnd->second.mapped;
+      free_decrypted (fnd->second);
+      decrypted_cache.erase (fnd);
+    }
+
+    /* make room by removing the oldest parts */
+    while (decrypted_size + d.mapped > decrypted_max && !decrypted_cache.empty ()) {
+      auto oldest = std::min_element (decrypted_cache.begin (), decrypted_cache.end (),
+          [] (const std::pair<const std::string, DecryptedPart> & a,
+              const std::pair<const std::string, DecryptedPart> & b) {
+            return a.second.added < b.second.added;
+          });
+
+      decrypted_size -= oldest->second.mapped;
+      free_decrypted (oldest->second);
+      decrypted_cache.erase (oldest);
+    }
+
+    decrypted_cache[digest] = d;
+    decrypted_size += d.mapped;
+  }
+
+  GMimeObject * Crypto::load_decrypted (std::string digest, GMimeDecryptResult ** res) {
+    std::lock_guard<std::mutex> lk (decrypted_m);
+
+    auto fnd = decrypted_cache.find (digest);
+    if (fnd == decrypted_cache.end ()) return NULL;
+
+    DecryptedPart & d = fnd->second;
+
+    if (decrypted_ttl > 0 && (time (NULL) - d.added) > decrypted_ttl) {
+      decrypted_size -= d.mapped;
+      free_decrypted (d);
+      decrypted_cache.erase (fnd);
+      return NULL;
+    }
+
+    /* the parsed part is used like a freshly decrypted part, its contents
+     * are sub-streams of the locked memory and keep it alive. */
+    GMimeStream * sub = g_mime_stream_substream (d.stream, 0, d.size);
+    GMimeParser * parser = g_mime_parser_new_with_stream (sub);
+    GMimeObject * dp = g_mime_parser_construct_part (parser);
+
+    g_object_unref (parser);
+    g_object_unref (sub);
+
+    if (dp == NULL) return NULL;
+
+    *res = d.res;
+    if (d.res) g_object_ref (d.res);
+
+    return dp;
+  }
+
+  void Crypto::free_decrypted (DecryptedPart & d) {
+    /* the pages are wiped when no parsed part uses them any more */
+    g_object_unref (d.stream);
+
+    if (d.res) g_object_unref (d.res);
+  }
+
+  bool Crypto::on_expire_timeout () {
+    expire_decrypted ();
+    return true;
+  }
+
+  void Crypto::expire_decrypted () {
+    std::lock_guard<std::mutex> lk (decrypted_m);
+
+    time_t now = time (NULL);
+
+    for (auto it = decrypted_cache.begin (); it != decrypted_cache.end (); ) {
+      if ((now - it->second.added) > decrypted_ttl) {
+        decrypted_size -= it->second.mapped;
+        free_decrypted (it->second);
+        it = decrypted_cache.erase (it);
+      } else {
+        it++;
+      }
+    }
+  }
+
+  void Crypto::wipe_decrypted () {
+    std::lock_guard<std::mutex> lk (decrypted_m);
+
+    for (auto &d : decrypted_cache) free_decrypted (d.second);
+
+    decrypted_cache.clear ();
+    decrypted_size = 0;
+  }
+  /* }}} */
+
+  std::string Crypto::get_part_digest (GMimeObject * mo) {
+    /* the caches hand out good signatures and plaintext by this key, so
+     * it must be collision resistant: sha-256 of the serialized part,
+     * prefixed with its length. */
+    GMimeStream * mem = g_mime_stream_mem_new ();
+    g_mime_object_write_to_stream (mo, mem);
+    g_mime_stream_flush (mem);
+
+    GByteArray * ba = g_mime_stream_mem_get_byte_array (GMIME_STREAM_MEM (mem));
+
+    GChecksum * sha = g_checksum_new (G_CHECKSUM_SHA256);
+    g_checksum_update (sha, ba->data, ba->len);
+
+    guint8 digest[32];
+    gsize  digest_len = sizeof (digest);
+    g_checksum_get_digest (sha, digest, &digest_len);
+    g_checksum_free (sha);
+
+    guint64 len = ba->len;
+    g_object_unref (mem);
+
+    std::string key (reinterpret_cast<const char *> (&len), sizeof (len));
+    key.append (reinterpret_cast<const char *> (digest), digest_len);
+
+    return key;
+  }
+
   bool Crypto::verify_signature_list (GMimeSignatureList * list) {
     if (list == NULL) return false;
 
@@ -175,6 +569,13 @@ namespace Astroid {
     }
     log << endl;
 
+    GMimeCryptoContext * gpgctx = acquire_context ();
+    if (gpgctx == NULL) {
+      g_ptr_array_free (recpa, false);
+      g_set_error (err, GMIME_ERROR, GMIME_ERROR_GENERAL, "could not create gpg context");
+      return false;
+    }
+
     *out = g_mime_multipart_encrypted_new ();
 
     int r = g_mime_multipart_encrypted_encrypt (
@@ -187,6 +588,7 @@ namespace Astroid {
         recpa,
         err);
 
+    release_context (gpgctx);
 
     g_ptr_array_free (recpa, false);
 
@@ -200,6 +602,12 @@ namespace Astroid {
   }
 
   bool Crypto::sign (GMimeObject * mo, ustring userid, GMimeMultipartSigned ** out, GError ** err) {
+    GMimeCryptoContext * gpgctx = acquire_context ();
+    if (gpgctx == NULL) {
+      g_set_error (err, GMIME_ERROR, GMIME_ERROR_GENERAL, "could not create gpg context");
+      return false;
+    }
+
     *out = g_mime_multipart_signed_new ();
 
     int r = g_mime_multipart_signed_sign (
@@ -210,6 +618,8 @@ namespace Astroid {
         GMIME_DIGEST_ALGO_DEFAULT,
         err);
 
+    release_context (gpgctx);
+
     if (r == 0) {
       log << debug << "crypto: successfully signed message." << endl;
     } else {
@@ -219,30 +629,38 @@ namespace Astroid {
     return (r == 0);
   }
 
-  bool Crypto::create_gpg_context () {
+  GMimeCryptoContext * Crypto::create_gpg_context () {
+    GMimeCryptoContext * gpgctx = g_mime_gpg_context_new (NULL, gpgpath.length() ? gpgpath.c_str () : "gpg");
 
-    if (!astroid->in_test ()) {
+    if (! gpgctx) {
+      log << error << "crypto: failed to create gpg context." << std::endl;
+      return NULL;
+    }
 
-      gpgctx = g_mime_gpg_context_new (NULL, gpgpath.length() ? gpgpath.c_str () : "gpg");
-      g_mime_gpg_context_set_use_agent ((GMimeGpgContext *) gpgctx, TRUE);
-      g_mime_gpg_context_set_always_trust ((GMimeGpgContext *) gpgctx, always_trust);
+    g_mime_gpg_context_set_use_agent ((GMimeGpgContext *) gpgctx, TRUE);
+    g_mime_gpg_context_set_always_trust ((GMimeGpgContext *) gpgctx, always_trust);
 
-    } else {
+    return gpgctx;
+  }
 
-      log << debug << "crypto: in test" << endl;
-      gpgctx = g_mime_gpg_context_new (NULL, "gpg");
-      g_mime_gpg_context_set_use_agent ((GMimeGpgContext *) gpgctx, TRUE);
-      g_mime_gpg_context_set_always_trust ((GMimeGpgContext *) gpgctx, TRUE);
+  GMimeCryptoContext * Crypto::acquire_context () {
+    std::unique_lock<std::mutex> lk (pool_m);
 
+    if (!pool.empty ()) {
+      GMimeCryptoContext * ctx = pool.back ();
+      pool.pop_back ();
+      return ctx;
     }
 
-    if (! gpgctx) {
-      log << error << "crypto: failed to create gpg context." << std::endl;
-      return false;
-    }
+    lk.unlock ();
 
+    log << debug << "crypto: creating gpg context." << endl;
+    return create_gpg_context ();
+  }
 
-    return true;
+  void Crypto::release_context (GMimeCryptoContext * ctx) {
+    std::lock_guard<std::mutex> lk (pool_m);
+    pool.push_back (ctx);
   }
 
   ustring Crypto::get_md5_digest (ustring str) {
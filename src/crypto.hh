@@ -1,5 +1,10 @@
 # pragma once
 
+# include <mutex>
+# include <vector>
+# include <map>
+# include <string>
+
 # include <gmime/gmime.h>
 # include <boost/property_tree/ptree.hpp>
 
@@ -38,16 +43,91 @@ namespace Astroid {
       GMimeCertificateList * rlist = NULL;
 
     private:
-      bool create_gpg_context ();
-      GMimeCryptoContext * gpgctx = NULL;
       ustring protocol;
-      ustring gpgpath;
-      bool    always_trust = false;
-      ptree config;
+
+      /* slist is a reference held by this object (from verify_signature) */
+      bool slist_owned = false;
 
       bool verify_signature_list (GMimeSignatureList *);
 
+      /* gpg contexts are shared by all Crypto objects: a context is taken
+       * from the pool for the duration of an operation, so that several
+       * threads may decrypt or verify at the same time. */
+      static std::mutex pool_m;
+      static std::vector<GMimeCryptoContext *> pool;
+
+      static ustring gpgpath;
+      static bool    always_trust;
+
+      static GMimeCryptoContext * create_gpg_context ();
+      static GMimeCryptoContext * acquire_context ();
+      static void release_context (GMimeCryptoContext *);
+
+      /* signature lists of verified parts by digest of the signed part,
+       * re-opening a message does not run gpg again. entries expire after
+       * verified_ttl seconds, and all are dropped when the keyring or trust
+       * db changes (keys may have been imported, revoked or trusted). */
+      struct VerifiedPart {
+        GMimeSignatureList * slist;
+        time_t               added;
+      };
+
+      static std::mutex verified_m;
+      static std::map<std::string, VerifiedPart> verified_cache;
+      static time_t verified_keyring;
+      static int    verified_ttl;
+      static const unsigned int MAX_VERIFIED = 1000;
+
+      static time_t keyring_mtime ();
+      static void clear_verified ();
+
+      /* cache key of a part: length and sha-256 of the serialized part */
+      static std::string get_part_digest (GMimeObject *);
+
+      /* decrypted parts by digest of the encrypted part, serialized to
+       * memory that is locked (never swapped) and wiped when freed.
+       *
+       * the locked pages belong to a memory stream: parts parsed from the
+       * cache read the pages through sub-streams without copying them, so
+       * the pages are wiped and freed when the cache has dropped the part
+       * and the last parsed part using it has been freed. */
+      struct DecryptedPart {
+        GMimeStream *        stream;
+        size_t               size;   // serialized part
+        size_t               mapped; // locked pages
+        GMimeDecryptResult * res;
+        time_t               added;
+      };
+
+      struct LockedPages {
+        void *       data;
+        size_t       mapped;
+        GByteArray * array;
+      };
+
+      static void free_locked_pages (gpointer);
+
+      static std::mutex decrypted_m;
+      static std::map<std::string, DecryptedPart> decrypted_cache;
+      static size_t decrypted_size;
+      static size_t decrypted_max;
+      static int    decrypted_ttl;
+
+      static void store_decrypted (std::string digest, GMimeObject *, GMimeDecryptResult *);
+      static GMimeObject * load_decrypted (std::string digest, GMimeDecryptResult **);
+      static void free_decrypted (DecryptedPart &);
+      static void expire_decrypted ();
+      static bool on_expire_timeout ();
+      static void wipe (void *, size_t);
+
     public:
+      static void init ();
+      static void destruct ();
+
+      /* free all cached decrypted parts, e.g. when the screen is locked.
+       * parts that are still shown are wiped when they are freed. */
+      static void wipe_decrypted ();
+
       static ustring get_md5_digest (ustring str);
       static unsigned char * get_md5_digest_char (ustring str);
   };
@@ -10,6 +10,8 @@
 # include <condition_variable>
 # include <mutex>
 
+# include <sys/stat.h>
+
 # include <glibmm.h>
 
 # include <notmuch.h>
@@ -29,6 +31,14 @@ namespace Astroid {
   std::mutex                Db::db_open;
   std::condition_variable   Db::dbs_open;
 
+  /* read-only handle pool */
+  std::mutex                    Db::ro_pool_m;
+  std::vector<Db::PooledHandle> Db::ro_pool;
+  unsigned long                 Db::ro_pool_generation = 0;
+# ifdef HAVE_NOTMUCH_GET_REV
+  unsigned long                 Db::ro_pool_revision = 0;
+# endif
+
   /* static settings */
   bool Db::maildir_synchronize_flags = false;
   std::vector<ustring> Db::excluded_tags = { "muted", "spam", "deleted" };
@@ -36,6 +46,9 @@ namespace Astroid {
   std::vector<ustring> Db::draft_tags = { "draft" };
   std::vector<ustring> Db::tags;
 
+  const std::vector<ustring> Db::maildir_flag_tags = {
+    "draft", "flagged", "passed", "replied", "unread" };
+
   bfs::path Db::path_db;
 
   void Db::init () {
@@ -139,6 +152,14 @@ namespace Astroid {
   bool Db::open_db_read_only () {
     Db::acquire_ro_lock ();
 
+    if (borrow_ro_handle ()) {
+      return true;
+    }
+
+    /* read the stamp before opening: a write in between makes the handle
+     * look stale rather than fresh */
+    unsigned long long stamp = disk_stamp ();
+
     notmuch_status_t s =
       notmuch_database_open (
         path_db.c_str(),
@@ -154,9 +175,110 @@ namespace Astroid {
       return false;
     }
 
+    /* tag the new handle so that it can be put back in the pool */
+    std::lock_guard<std::mutex> plk (ro_pool_m);
+    pooled.nm_db      = nm_db;
+    pooled.generation = ro_pool_generation;
+    pooled.stamp      = stamp;
+
+# ifdef HAVE_NOTMUCH_GET_REV
+    pooled.revision = notmuch_database_get_revision (nm_db, NULL);
+    if (pooled.revision > ro_pool_revision) ro_pool_revision = pooled.revision;
+# endif
+
     return true;
   }
 
+  unsigned long long Db::disk_stamp () {
+    /* xapian commits by renaming a new version file into the database
+     * directory, so its modification time changes on every write - also
+     * on writes by other processes (notmuch new, the notmuch cli, sync
+     * hooks). returns 0 if the directory cannot be read. */
+    path xapian = path_db / ".notmuch" / "xapian";
+
+    struct stat st;
+    if (stat (xapian.c_str (), &st) != 0) return 0;
+
+    return (unsigned long long) st.st_mtim.tv_sec * 1000000000ULL +
+           (unsigned long long) st.st_mtim.tv_nsec;
+  }
+
+  bool Db::borrow_ro_handle () {
+    /* must be called with the read-only lock held */
+    std::lock_guard<std::mutex> plk (ro_pool_m);
+
+    if (ro_pool.empty ()) return false;
+
+    unsigned long long stamp = disk_stamp ();
+    auto now = chrono::steady_clock::now ();
+
+    while (!ro_pool.empty ()) {
+      PooledHandle h = ro_pool.back ();
+      ro_pool.pop_back ();
+
+      bool stale = (h.generation != ro_pool_generation);
+# ifdef HAVE_NOTMUCH_GET_REV
+      /* a handle opened later has seen a newer revision of the db */
+      stale |= (h.revision < ro_pool_revision);
+# endif
+
+      /* the database has been written to since the handle was opened,
+       * possibly by another process. */
+      stale |= (stamp == 0 || h.stamp != stamp);
+
+      /* do not trust the stamp forever (coarse timestamps on some file
+       * systems): close handles that have been idle for a while. */
+      stale |= (now - h.idle_since) > chrono::seconds (ro_pool_max_idle_time);
+
+      if (stale) {
+        log << debug << "db: ro-pool: closing stale handle." << endl;
+        notmuch_database_close (h.nm_db);
+        continue;
+      }
+
+      log << debug << "db: ro-pool: reusing handle (idle: " << ro_pool.size () << ")" << endl;
+      pooled = h;
+      nm_db  = h.nm_db;
+      return true;
+    }
+
+    return false;
+  }
+
+  void Db::return_ro_handle () {
+    /* must be called before the read-only lock is released */
+    std::lock_guard<std::mutex> plk (ro_pool_m);
+
+    bool stale = (pooled.generation != ro_pool_generation);
+# ifdef HAVE_NOTMUCH_GET_REV
+    stale |= (pooled.revision < ro_pool_revision);
+# endif
+
+    if (stale || ro_pool.size () >= ro_pool_max_idle) {
+      log << info << "db: closing db." << endl;
+      notmuch_database_close (nm_db);
+    } else {
+      pooled.idle_since = chrono::steady_clock::now ();
+      ro_pool.push_back (pooled);
+    }
+
+    nm_db = NULL;
+  }
+
+  void Db::invalidate_ro_pool () {
+    std::lock_guard<std::mutex> plk (ro_pool_m);
+
+    log << debug << "db: ro-pool: invalidating " << ro_pool.size () << " idle handles." << endl;
+
+    ro_pool_generation++;
+
+    for (auto &h : ro_pool) {
+      notmuch_database_close (h.nm_db);
+    }
+
+    ro_pool.clear ();
+  }
+
   std::unique_lock<std::mutex> Db::acquire_rw_lock () {
     /* lock will wait for all read-onlys to close, lk will not be released before
      * db is closed */
@@ -170,6 +292,12 @@ namespace Astroid {
 
   void Db::release_rw_lock (std::unique_lock<std::mutex> &rwl) {
     log << debug << "db: rw-s: releasing lock." << endl;
+
+    /* the database may have changed: pooled read-only handles are
+     * snapshots of the old state, invalidate them before any new read-only
+     * db can be opened. */
+    invalidate_ro_pool ();
+
     rwl.unlock ();
     dbs_open.notify_all ();
   }
@@ -197,9 +325,13 @@ namespace Astroid {
       closed = true;
 
       if (nm_db != NULL) {
-        log << info << "db: closing db." << endl;
-        notmuch_database_close (nm_db);
-        nm_db = NULL;
+        if (mode == DATABASE_READ_ONLY) {
+          return_ro_handle ();
+        } else {
+          log << info << "db: closing db." << endl;
+          notmuch_database_close (nm_db);
+          nm_db = NULL;
+        }
       }
 
       if (mode == DATABASE_READ_WRITE) {
@@ -223,6 +355,13 @@ namespace Astroid {
     return revision;
   }
 
+  ustring Db::get_uuid () {
+    const char *uuid;
+    notmuch_database_get_revision (nm_db, &uuid);
+
+    return ustring (uuid);
+  }
+
 # endif
 
   void Db::load_tags () {
@@ -359,6 +498,134 @@ namespace Astroid {
     return (st == NOTMUCH_STATUS_SUCCESS) && (c == 1);
   }
 
+  bool Db::tag_threads (
+      vector<ustring> thread_ids,
+      vector<ustring> add,
+      vector<ustring> remove)
+  {
+    /* sanitize and check tags */
+    for (auto v : { &add, &remove }) {
+      for (auto &t : *v) t = sanitize_tag (t);
+
+      auto bad = find_if (v->begin (), v->end (),
+          [&] (ustring &t) { return !check_tag (t); });
+
+      if (bad != v->end ()) {
+        log << error << "db: bulk tag: invalid tag: " << *bad << endl;
+        return false;
+      }
+    }
+
+    if (thread_ids.empty () || (add.empty () && remove.empty ())) return true;
+
+    time_t t0 = clock ();
+
+    /* only match messages that will change: messages that are missing one
+     * of the tags to add or have one of the tags to remove. */
+    ustring change_q;
+    for (auto &t : add) {
+      if (!change_q.empty ()) change_q += " OR ";
+      change_q += "(NOT tag:\"" + t + "\")";
+    }
+    for (auto &t : remove) {
+      if (!change_q.empty ()) change_q += " OR ";
+      change_q += "tag:\"" + t + "\"";
+    }
+
+    auto flag_tag = [&] (ustring &t) { return has (maildir_flag_tags, t); };
+
+    bool sync_flags = maildir_synchronize_flags && (
+        any_of (add.begin (), add.end (), flag_tag) ||
+        any_of (remove.begin (), remove.end (), flag_tag));
+
+    bool res = true;
+    unsigned int changed = 0;
+
+    /* keep the query at a sane length for very large selections */
+    const unsigned int threads_per_query = 100;
+
+    for (unsigned int i = 0; i < thread_ids.size (); i += threads_per_query) {
+      ustring thread_q;
+
+      for (unsigned int j = i; j < min ((unsigned int) thread_ids.size (), i + threads_per_query); j++) {
+        if (!thread_q.empty ()) thread_q += " OR ";
+        thread_q += "thread:" + thread_ids[j];
+      }
+
+      ustring query_s = "(" + thread_q + ") AND (" + change_q + ")";
+
+      notmuch_query_t * query = notmuch_query_create (nm_db, query_s.c_str ());
+      notmuch_messages_t * messages;
+      notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+
+# ifdef HAVE_QUERY_THREADS_ST
+      st = notmuch_query_search_messages_st (query, &messages);
+# else
+      messages = notmuch_query_search_messages (query);
+# endif
+
+      if ((st != NOTMUCH_STATUS_SUCCESS) || messages == NULL) {
+        log << error << "db: bulk tag: could not search messages, status: " << st << endl;
+        notmuch_query_destroy (query);
+        return false;
+      }
+
+      for (; notmuch_messages_valid (messages);
+             notmuch_messages_move_to_next (messages)) {
+
+        notmuch_message_t * message = notmuch_messages_get (messages);
+
+        notmuch_status_t s = notmuch_message_freeze (message);
+
+        for (auto &t : add) {
+          if (s != NOTMUCH_STATUS_SUCCESS) break;
+          s = notmuch_message_add_tag (message, t.c_str ());
+        }
+
+        for (auto &t : remove) {
+          if (s != NOTMUCH_STATUS_SUCCESS) break;
+          s = notmuch_message_remove_tag (message, t.c_str ());
+        }
+
+        if (s == NOTMUCH_STATUS_SUCCESS) {
+          s = notmuch_message_thaw (message);
+        } else {
+          /* never destroy a frozen message: thaw it so that the tags that
+           * were changed are consistent, and report the failure. */
+          log << error << "db: bulk tag: could not tag message: " << notmuch_message_get_message_id (message) << ", status: " << s << endl;
+          notmuch_message_thaw (message);
+        }
+
+        if ((s == NOTMUCH_STATUS_SUCCESS) && sync_flags) {
+          s = notmuch_message_tags_to_maildir_flags (message);
+        }
+
+        if (s == NOTMUCH_STATUS_SUCCESS) {
+          changed++;
+        } else {
+          res = false;
+        }
+
+        notmuch_message_destroy (message);
+      }
+
+      notmuch_query_destroy (query);
+    }
+
+    if (res) {
+      /* add to global tag list */
+      for (auto &t : add) {
+        if (find (tags.begin (), tags.end (), t) == tags.end ()) {
+          tags.push_back (t);
+        }
+      }
+    }
+
+    log << debug << "db: bulk tag: " << thread_ids.size () << " threads, " << changed << " messages changed in " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms." << endl;
+
+    return res;
+  }
+
   void Db::on_thread (ustring thread_id, function<void(notmuch_thread_t *)> func) {
 
     string query_s = "thread:" + thread_id;
@@ -464,7 +731,13 @@ namespace Astroid {
    * notmuch thread
    * --------------
    */
-  NotmuchThread::NotmuchThread (notmuch_thread_t * t) {
+  std::atomic<unsigned int> NotmuchThread::versions (0);
+
+  unsigned int NotmuchThread::next_version () {
+    return ++versions;
+  }
+
+  NotmuchThread::NotmuchThread (notmuch_thread_t * t, bool details) {
     const char * ti = notmuch_thread_get_thread_id (t);
     if (ti == NULL) {
       log << error << "nmt: got NULL thread id." << endl;
@@ -473,7 +746,18 @@ namespace Astroid {
 
     thread_id = ti;
 
-    load (t);
+    load (t, details);
+  }
+
+  NotmuchThread::NotmuchThread (ustring _thread_id) :
+    thread_id (_thread_id)
+  {
+    unread     = false;
+    attachment = false;
+    flagged    = false;
+    newest_date = 0;
+    oldest_date = 0;
+    total_messages = 0;
   }
 
   NotmuchThread::~NotmuchThread () {
@@ -491,23 +775,31 @@ namespace Astroid {
         });
   }
 
-  void NotmuchThread::load (notmuch_thread_t * nm_thread) {
+  void NotmuchThread::load (notmuch_thread_t * nm_thread, bool details) {
     unread     = false;
     attachment = false;
     flagged    = false;
 
     /* update values */
-    const char * s = notmuch_thread_get_subject (nm_thread); // belongs to thread
-
-    if (s != NULL) {
-      subject = ustring (s);
-    }
-
     newest_date = notmuch_thread_get_newest_date (nm_thread);
     oldest_date = notmuch_thread_get_oldest_date (nm_thread);
     total_messages = check_total_messages (nm_thread);
     tags        = get_tags (nm_thread);
-    authors     = get_authors (nm_thread);
+
+    if (details) {
+      const char * s = notmuch_thread_get_subject (nm_thread); // belongs to thread
+
+      if (s != NULL) {
+        subject = ustring (s);
+      }
+
+      /* depends on unread, set by get_tags () */
+      authors = get_authors (nm_thread);
+
+      details_loaded = true;
+    }
+
+    version = next_version ();
   }
 
   vector<ustring> NotmuchThread::get_tags (notmuch_thread_t * nm_thread) {
@@ -649,57 +941,20 @@ namespace Astroid {
       return false;
     }
 
-    bool res = true;
-
-    db->on_thread (thread_id, [&](notmuch_thread_t * nm_thread)
-      {
-        if (find(tags.begin (), tags.end (), tag) == tags.end ()) {
-          /* get messages from thread */
-          notmuch_messages_t * qmessages;
-          notmuch_message_t  * message;
-
-
-          for (qmessages = notmuch_thread_get_messages (nm_thread);
-               notmuch_messages_valid (qmessages);
-               notmuch_messages_move_to_next (qmessages)) {
-
-            message = notmuch_messages_get (qmessages);
-
-            notmuch_status_t s = notmuch_message_add_tag (message, tag.c_str ());
-
-            if ((s == NOTMUCH_STATUS_SUCCESS) && db->maildir_synchronize_flags) {
-              s = notmuch_message_tags_to_maildir_flags (message);
-            }
-
-            notmuch_message_destroy (message);
-
-            if (s == NOTMUCH_STATUS_SUCCESS) {
-              res &= true;
-            } else {
-              log << error << "nm: could not add tag: " << tag << " to thread: " << thread_id << endl;
-              res = false;
-              return;
-            }
-          }
-
-          if (res) {
-            tags.push_back (tag);
+    if (find(tags.begin (), tags.end (), tag) != tags.end ()) {
+      return false;
+    }
 
-            // add to global tag list
-            if (find(db->tags.begin (),
-                  db->tags.end (),
-                  tag) == db->tags.end ()) {
-              db->tags.push_back (tag);
-            }
-          }
+    if (!db->tag_threads ({ thread_id }, { tag }, {})) {
+      log << error << "nm: could not add tag: " << tag << " to thread: " << thread_id << endl;
+      return false;
+    }
 
-          res = true;
-        } else {
-          res = false;
-        }
-      });
+    tags.push_back (tag);
+    sort (tags.begin (), tags.end ());
+    version = next_version ();
 
-    return res;
+    return true;
   }
 
   bool NotmuchThread::remove_tag (Db * db, ustring tag) {
@@ -710,55 +965,22 @@ namespace Astroid {
       return false;
     }
 
-    bool res = true;
-    db->on_thread (thread_id, [&](notmuch_thread_t * nm_thread)
-      {
-
-        if (find(tags.begin (), tags.end (), tag) != tags.end ()) {
-
-          /* get messages from thread */
-          notmuch_messages_t * qmessages;
-          notmuch_message_t  * message;
-
-
-          for (qmessages = notmuch_thread_get_messages (nm_thread);
-               notmuch_messages_valid (qmessages);
-               notmuch_messages_move_to_next (qmessages)) {
-
-            message = notmuch_messages_get (qmessages);
-
-            notmuch_status_t s = notmuch_message_remove_tag (message, tag.c_str ());
-
-            if ((s == NOTMUCH_STATUS_SUCCESS) && db->maildir_synchronize_flags) {
-              s = notmuch_message_tags_to_maildir_flags (message);
-            }
-
-            notmuch_message_destroy (message);
-
-            if (s == NOTMUCH_STATUS_SUCCESS) {
-              res &= true;
-            } else {
-              log << error << "nm: could not remove tag: " << tag << " from thread: " << thread_id << endl;
-              res = false;
-              return;
-            }
-
-          }
+    if (find(tags.begin (), tags.end (), tag) == tags.end ()) {
+      log << warn << "nm: thread does not have tag." << endl;
+      return false;
+    }
 
-          if (res) {
-            tags.erase (remove (tags.begin (),
-                                tags.end (),
-                                tag), tags.end ());
-          }
+    if (!db->tag_threads ({ thread_id }, {}, { tag })) {
+      log << error << "nm: could not remove tag: " << tag << " from thread: " << thread_id << endl;
+      return false;
+    }
 
-          res = true;
-        } else {
-          log << warn << "nm: thread does not have tag." << endl;
-          res = false;
-        }
-      });
+    tags.erase (remove (tags.begin (),
+                        tags.end (),
+                        tag), tags.end ());
+    version = next_version ();
 
-    return res;
+    return true;
   }
 
 
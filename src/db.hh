@@ -4,6 +4,7 @@
 # include <condition_variable>
 # include <atomic>
 # include <functional>
+# include <chrono>
 
 # include <vector>
 
@@ -46,7 +47,8 @@ namespace Astroid {
   /* the notmuch thread object should get by on the db only */
   class NotmuchThread : public NotmuchTaggable {
     public:
-      NotmuchThread (notmuch_thread_t *);
+      NotmuchThread (notmuch_thread_t *, bool details = true);
+      NotmuchThread (ustring thread_id); // fields must be set by caller
       ~NotmuchThread ();
 
       ustring thread_id;
@@ -60,8 +62,20 @@ namespace Astroid {
       int     total_messages;
       std::vector<std::tuple<ustring,bool>> authors;
 
+      /* the subject and authors are only loaded for displayed threads
+       * (see ThreadIndexListStore::get_thread), the remaining fields are
+       * always loaded. */
+      bool details_loaded = false;
+
+      /* changed whenever the fields change, used to cache the rendered
+       * thread index row. versions are unique over all thread objects, a
+       * new object for the same thread never gets the version of an old
+       * one. */
+      unsigned int version = next_version ();
+      static unsigned int next_version ();
+
       void refresh (Db *);
-      void load (notmuch_thread_t *);
+      void load (notmuch_thread_t *, bool details = true);
 
       bool remove_tag (Db *, ustring) override;
       bool add_tag (Db *, ustring) override;
@@ -69,6 +83,8 @@ namespace Astroid {
       ustring str () override;
 
     private:
+      static std::atomic<unsigned int> versions;
+
       int check_total_messages (notmuch_thread_t *);
       std::vector<std::tuple<ustring,bool>> get_authors (notmuch_thread_t *);
       std::vector<ustring> get_tags (notmuch_thread_t *);
@@ -90,8 +106,20 @@ namespace Astroid {
 
       bool thread_in_query (ustring, ustring);
 
+      /* bulk tagging: add and remove tags on all messages in the given
+       * threads. only messages that do not already have the resulting
+       * tags are touched, maildir flags are only synced for messages
+       * where a flag-relevant tag changed. */
+      bool tag_threads (std::vector<ustring> thread_ids,
+                        std::vector<ustring> add,
+                        std::vector<ustring> remove);
+
+      /* tags that are synchronized to maildir flags by notmuch */
+      static const std::vector<ustring> maildir_flag_tags;
+
 # ifdef HAVE_NOTMUCH_GET_REV
       unsigned long get_revision ();
+      ustring       get_uuid ();
 # endif
 
       notmuch_database_t * nm_db;
@@ -120,6 +148,11 @@ namespace Astroid {
       static void acquire_ro_lock ();
       static void release_ro_lock ();
 
+      /* close all idle read-only handles in the pool, use if the database
+       * may have been modified by an external program without holding the
+       * read-write lock (e.g. the poll script). */
+      static void invalidate_ro_pool ();
+
       static bool maildir_synchronize_flags;
       static void init ();
       static bfs::path path_db;
@@ -156,6 +189,44 @@ namespace Astroid {
       bool open_db_read_only ();
       bool closed = false;
 
+      /*
+       * Pool of read-only handles
+       *
+       * Opening a notmuch database is expensive, so read-only handles are
+       * kept open after use and lent out to the next read-only Db. A
+       * handle is a snapshot of the database at the time it was opened,
+       * the pool is therefore invalidated every time the read-write lock is
+       * released (the generation is bumped), and stale handles are closed
+       * instead of being returned to the pool.
+       *
+       * Borrowed handles are still counted in read_only_dbs_open, idle
+       * handles in the pool are not.
+       */
+      struct PooledHandle {
+        notmuch_database_t * nm_db;
+        unsigned long generation;
+        unsigned long long stamp;
+        std::chrono::steady_clock::time_point idle_since;
+# ifdef HAVE_NOTMUCH_GET_REV
+        unsigned long revision;
+# endif
+      };
+
+      static std::mutex                 ro_pool_m;
+      static std::vector<PooledHandle>  ro_pool;
+      static unsigned long              ro_pool_generation;
+# ifdef HAVE_NOTMUCH_GET_REV
+      static unsigned long              ro_pool_revision;
+# endif
+      static const unsigned int         ro_pool_max_idle = 4;
+      static const int                  ro_pool_max_idle_time = 5; // seconds
+
+      static unsigned long long disk_stamp ();
+      bool borrow_ro_handle ();
+      void return_ro_handle ();
+
+      PooledHandle pooled;
+
       const int db_write_open_timeout = 120; // seconds
       const int db_write_open_delay   = 1;   // seconds
 
@@ -0,0 +1,307 @@
+# include <functional>
+
+# include <sys/stat.h>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "message_cache.hh"
+# include "message_thread.hh"
+# include "message_source.hh"
+# include "chunk.hh"
+# include "db.hh"
+# include "log.hh"
+# include "actions/action_manager.hh"
+
+using std::endl;
+
+namespace Astroid {
+  MessageCache::MessageCache (size_t _max_size, size_t _max_count) :
+    max_size (_max_size),
+    max_count (_max_count)
+  {
+    enabled = (max_size > 0);
+
+    if (!enabled) return;
+
+    astroid->actions->signal_message_updated ().connect (
+        sigc::mem_fun (this, &MessageCache::on_message_updated));
+  }
+
+  bool MessageCache::file_mtime (ustring fname, time_t & mtime) {
+    struct stat st;
+    if (stat (fname.c_str (), &st) != 0) return false;
+
+    mtime = st.st_mtime;
+    return true;
+  }
+
+  bool MessageCache::cacheable (refptr<Message> msg) {
+    if (!msg->in_notmuch || !msg->has_file || msg->missing_content || !msg->root) {
+      return false;
+    }
+
+    bool encrypted = false;
+
+    std::function<void (refptr<Chunk>)> check = [&] (refptr<Chunk> c) {
+      if (c->isencrypted) encrypted = true;
+
+      for (auto &k : c->kids) {
+        if (encrypted) return;
+        check (k);
+      }
+    };
+
+    check (msg->root);
+
+    return !encrypted;
+  }
+
+  size_t MessageCache::estimate_size (refptr<Message> msg) {
+    /* the mapped file plus the parsed parts */
+    size_t sz = 4096;
+
+    if (msg->source) sz += msg->source->size ();
+
+    std::function<void (refptr<Chunk>)> count = [&] (refptr<Chunk> c) {
+      sz += 512;
+      for (auto &k : c->kids) count (k);
+    };
+
+    count (msg->root);
+
+    return sz;
+  }
+
+  refptr<Message> MessageCache::get (ustring mid, ustring fname) {
+    if (!enabled) return refptr<Message> ();
+
+    time_t mtime;
+    bool have_file = file_mtime (fname, mtime);
+
+    std::lock_guard<std::mutex> lk (m);
+
+    auto fnd = index.find (mid);
+
+    if (fnd == index.end ()) {
+      misses++;
+      return refptr<Message> ();
+    }
+
+    auto e = fnd->second;
+
+    if (!have_file || e->fname != fname.raw () || e->mtime != mtime) {
+      log << debug << "mc: file changed, dropping: " << mid << endl;
+      erase (e);
+      misses++;
+      return refptr<Message> ();
+    }
+
+    /* move to front */
+    lru.splice (lru.begin (), lru, e);
+    hits++;
+
+    return e->message;
+  }
+
+  bool MessageCache::contains (ustring mid, ustring fname) {
+    if (!enabled) return false;
+
+    time_t mtime;
+    if (!file_mtime (fname, mtime)) return false;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    auto fnd = index.find (mid);
+
+    return (fnd != index.end () &&
+            fnd->second->fname == fname.raw () &&
+            fnd->second->mtime == mtime);
+  }
+
+  void MessageCache::put (refptr<Message> msg) {
+    if (!enabled || !msg) return;
+
+    if (!cacheable (msg)) return;
+
+    time_t mtime;
+    if (!file_mtime (msg->fname, mtime)) return;
+
+    size_t sz = estimate_size (msg);
+    if (sz > max_size) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    auto fnd = index.find (msg->mid);
+    if (fnd != index.end ()) erase (fnd->second);
+
+    Entry e;
+    e.mid     = msg->mid;
+    e.fname   = msg->fname;
+    e.mtime   = mtime;
+    e.size    = sz;
+    e.message = msg;
+
+    lru.push_front (e);
+    index[e.mid] = lru.begin ();
+    current_size += sz;
+
+    evict ();
+  }
+
+  refptr<Message> MessageCache::load (notmuch_message_t * nm_msg, int level) {
+    ustring mid = notmuch_message_get_message_id (nm_msg);
+    const char * fn = notmuch_message_get_filename (nm_msg);
+
+    refptr<Message> msg;
+
+    if (fn != NULL) msg = get (mid, fn);
+
+    if (msg) {
+      /* tags may have been changed on the thread, which is not signalled
+       * per message */
+      msg->level = level;
+      msg->load_tags (nm_msg);
+    } else {
+      msg = refptr<Message> (new Message (nm_msg, level));
+      put (msg);
+    }
+
+    return msg;
+  }
+
+  bool MessageCache::begin_parse (ustring mid) {
+    std::lock_guard<std::mutex> lk (parsing_m);
+
+    if (parsing.count (mid)) return false;
+
+    parsing[mid] = Parsing ();
+    return true;
+  }
+
+  bool MessageCache::end_parse (ustring mid, refptr<Message> msg) {
+    std::unique_lock<std::mutex> lk (parsing_m);
+
+    auto fnd = parsing.find (mid);
+    if (fnd == parsing.end ()) return false;
+
+    if (fnd->second.taken) {
+      /* the waiting loader erases the entry */
+      fnd->second.done    = true;
+      fnd->second.message = msg;
+
+      lk.unlock ();
+      parsing_cv.notify_all ();
+
+      return true;
+    }
+
+    parsing.erase (fnd);
+    return false;
+  }
+
+  bool MessageCache::take_parse (ustring mid, refptr<Message> & msg) {
+    std::unique_lock<std::mutex> lk (parsing_m);
+
+    auto fnd = parsing.find (mid);
+    if (fnd == parsing.end () || fnd->second.taken) return false;
+
+    fnd->second.taken = true;
+
+    parsing_cv.wait (lk, [&] { return parsing[mid].done; });
+
+    msg = parsing[mid].message;
+    parsing.erase (mid);
+
+    return bool(msg);
+  }
+
+  void MessageCache::erase (std::list<Entry>::iterator e) {
+    /* requires lock */
+    current_size -= e->size;
+    index.erase (e->mid);
+    lru.erase (e);
+  }
+
+  void MessageCache::evict () {
+    /* requires lock */
+    while (!lru.empty () &&
+        (current_size > max_size || (max_count > 0 && lru.size () > max_count)))
+    {
+      erase (--lru.end ());
+    }
+  }
+
+  void MessageCache::invalidate (ustring mid) {
+    std::lock_guard<std::mutex> lk (m);
+
+    auto fnd = index.find (mid);
+    if (fnd != index.end ()) erase (fnd->second);
+  }
+
+  void MessageCache::clear () {
+    std::lock_guard<std::mutex> lk (m);
+
+    index.clear ();
+    lru.clear ();
+    current_size = 0;
+  }
+
+  void MessageCache::on_message_updated (Db * db, ustring mid) {
+    std::lock_guard<std::mutex> lk (m);
+
+    auto fnd = index.find (mid);
+    if (fnd == index.end ()) return;
+
+    auto e = fnd->second;
+
+    /* a message file renamed by flag changes keeps its contents, anything
+     * else drops the message */
+    bool keep = false;
+
+    db->on_message (mid, [&](notmuch_message_t * nm_msg)
+      {
+        if (nm_msg == NULL) return;
+
+        const char * fn = notmuch_message_get_filename (nm_msg);
+        time_t mtime;
+
+        if (fn != NULL && file_mtime (fn, mtime) && mtime == e->mtime) {
+          e->fname = fn;
+          keep = true;
+        }
+      });
+
+    if (!keep) {
+      log << debug << "mc: message updated, dropping: " << mid << endl;
+      erase (e);
+    }
+  }
+
+  size_t MessageCache::size () {
+    std::lock_guard<std::mutex> lk (m);
+    return current_size;
+  }
+
+  size_t MessageCache::count () {
+    std::lock_guard<std::mutex> lk (m);
+    return lru.size ();
+  }
+
+  ustring MessageCache::stats () {
+    std::lock_guard<std::mutex> lk (m);
+
+    unsigned long total = hits + misses;
+
+    return ustring::compose (
+        "mc: %1 of %7 messages, %2 of %3 kB, %4 hits, %5 misses (%6%% hit rate)",
+        lru.size (),
+        current_size / 1024,
+        max_size / 1024,
+        hits,
+        misses,
+        (total > 0 ? (hits * 100 / total) : 0),
+        (max_count > 0 ? std::to_string (max_count) : std::string ("unlimited")));
+  }
+}
+
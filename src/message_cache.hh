@@ -0,0 +1,111 @@
+# pragma once
+
+# include <mutex>
+# include <condition_variable>
+# include <list>
+# include <string>
+# include <unordered_map>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "proto.hh"
+
+namespace Astroid {
+  /* cache of parsed messages
+   *
+   * parsed messages are shared between thread views, replies and forwards
+   * so that re-opening a thread does not parse the message files again.
+   * a message is valid as long as its file (name and modification time)
+   * is unchanged. the least recently used messages are dropped when the
+   * estimated size of the cached messages grows beyond the maximum size,
+   * or when there are more than the maximum number of messages.
+   *
+   * messages with encrypted parts are never cached, decrypted content is
+   * kept by Crypto only.
+   *
+   * get (), contains () and the parsing functions may be called from the
+   * message loader and prefetch threads, everything else must run on the
+   * gui thread.
+   */
+  class MessageCache : public sigc::trackable {
+    public:
+      /* max_size is in bytes, 0 disables the cache. max_count is the
+       * maximum number of messages, 0 for no limit. */
+      MessageCache (size_t max_size, size_t max_count = 0);
+
+      bool enabled;
+
+      /* returns the message if it was parsed from the same file, or an
+       * empty refptr */
+      refptr<Message> get (ustring mid, ustring fname);
+
+      /* like get, but does not count as a hit or miss or change the order */
+      bool contains (ustring mid, ustring fname);
+
+      void put (refptr<Message>);
+      void invalidate (ustring mid);
+      void clear ();
+
+      /* returns the cached message with tags and level updated, or loads
+       * and caches it */
+      refptr<Message> load (notmuch_message_t *, int level);
+
+      /* messages being parsed by the prefetcher. begin_parse returns false
+       * if the message is already being parsed. a message loader that needs
+       * a message that is being parsed takes it over with take_parse, which
+       * waits for the parse to finish, rather than parsing it again.
+       * end_parse returns true if the message was taken over, otherwise it
+       * is left to the caller. */
+      bool begin_parse (ustring mid);
+      bool end_parse (ustring mid, refptr<Message>);
+      bool take_parse (ustring mid, refptr<Message> &);
+
+      size_t size ();
+      size_t count ();
+
+      unsigned long hits   = 0;
+      unsigned long misses = 0;
+
+      ustring stats ();
+
+    private:
+      std::mutex m;
+
+      size_t max_size;
+      size_t max_count;
+      size_t current_size = 0;
+
+      struct Entry {
+        std::string     mid;
+        std::string     fname;
+        time_t          mtime;
+        size_t          size;
+        refptr<Message> message;
+      };
+
+      /* most recently used first */
+      std::list<Entry> lru;
+      std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+      static bool   file_mtime (ustring fname, time_t &);
+      static size_t estimate_size (refptr<Message>);
+      static bool   cacheable (refptr<Message>);
+
+      struct Parsing {
+        bool            done  = false;
+        bool            taken = false;
+        refptr<Message> message;
+      };
+
+      std::mutex              parsing_m;
+      std::condition_variable parsing_cv;
+      std::unordered_map<std::string, Parsing> parsing;
+
+      void erase (std::list<Entry>::iterator);
+      void evict ();
+
+      void on_message_updated (Db *, ustring);
+  };
+}
+
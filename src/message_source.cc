@@ -0,0 +1,199 @@
+# include <fstream>
+
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+# include <gmime/gmime.h>
+
+# include "astroid.hh"
+# include "message_source.hh"
+# include "log.hh"
+
+using std::endl;
+
+namespace Astroid {
+  /* a mapping kept alive by the stream reading it */
+  struct Mapping {
+    void *       map;
+    size_t       len;
+    GByteArray * array;
+  };
+
+  static void unmap (gpointer data) {
+    Mapping * m = static_cast<Mapping *> (data);
+
+    /* the array does not own the mapped bytes */
+    g_byte_array_free (m->array, false);
+    munmap (m->map, m->len);
+
+    delete m;
+  }
+
+  MessageSource::MessageSource (ustring _fname) : fname (_fname) {
+    int fd = open (fname.c_str (), O_RDONLY);
+
+    if (fd < 0) {
+      log << error << "ms: could not open: " << fname << endl;
+      return;
+    }
+
+    struct stat st;
+    if (fstat (fd, &st) != 0) {
+      log << error << "ms: could not stat: " << fname << endl;
+      close (fd);
+      return;
+    }
+
+    size_t len = st.st_size;
+
+    if (len >= map_threshold) {
+      void * map = mmap (NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (map != MAP_FAILED) {
+        /* a memory stream over the mapped bytes: the stream does not own
+         * the array, the mapping is released with the stream (the parts of
+         * the message hold references to it). */
+        Mapping * m = new Mapping ();
+        m->map   = map;
+        m->len   = len;
+        m->array = g_byte_array_new_take (static_cast<guint8 *> (map), len);
+
+        source = g_mime_stream_mem_new_with_byte_array (m->array);
+        g_mime_stream_mem_set_owner (GMIME_STREAM_MEM (source), false);
+
+        g_object_set_data_full (G_OBJECT (source), "astroid-mapping", m, &unmap);
+
+        map_dev = st.st_dev;
+        map_ino = st.st_ino;
+
+        is_mapped    = true;
+        is_in_memory = true;
+      }
+
+    } else {
+      /* small files are read at once, a mapping per message would cost
+       * more than the copy. */
+      GByteArray * array = g_byte_array_sized_new (len);
+      g_byte_array_set_size (array, len);
+
+      size_t pos = 0;
+      while (pos < len) {
+        ssize_t r = read (fd, array->data + pos, len - pos);
+        if (r <= 0) break;
+        pos += r;
+      }
+
+      if (pos == len) {
+        source = g_mime_stream_mem_new_with_byte_array (array); // owns array
+        is_in_memory = true;
+      } else {
+        g_byte_array_free (array, true);
+      }
+    }
+
+    close (fd);
+
+    if (source == NULL) {
+      log << debug << "ms: could not read into memory: " << fname << ", reading file." << endl;
+      source = g_mime_stream_file_new_for_path (fname.c_str (), "r");
+    }
+  }
+
+  MessageSource::~MessageSource () {
+    /* the parts of a parsed message keep their own references */
+    if (source != NULL) g_object_unref (source);
+  }
+
+  GMimeStream * MessageSource::stream () {
+    if (source != NULL) g_mime_stream_reset (source);
+
+    return source;
+  }
+
+  bool MessageSource::truncated () {
+    if (!is_mapped) return false;
+
+    /* a replaced file (new inode) does not affect the mapping */
+    struct stat st;
+    if (stat (fname.c_str (), &st) != 0) return false;
+
+    if (st.st_dev == map_dev && st.st_ino == map_ino &&
+        static_cast<size_t> (st.st_size) < size ())
+    {
+      log << error << "ms: file has been truncated while mapped: " << fname << endl;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool MessageSource::in_memory () {
+    return is_in_memory && !truncated ();
+  }
+
+  bool MessageSource::mapped () {
+    return is_mapped;
+  }
+
+  const char * MessageSource::data () {
+    if (!is_in_memory) return NULL;
+
+    return reinterpret_cast<const char *> (GMIME_STREAM_MEM (source)->buffer->data);
+  }
+
+  size_t MessageSource::size () {
+    if (is_in_memory) {
+      return GMIME_STREAM_MEM (source)->buffer->len;
+    } else if (source != NULL) {
+      gint64 len = g_mime_stream_length (source);
+      return (len > 0 ? static_cast<size_t> (len) : 0);
+    } else {
+      return 0;
+    }
+  }
+
+  bool MessageSource::write_to (ustring tofname) {
+    if (source == NULL) return false;
+
+    if (in_memory ()) {
+      std::ofstream dst (tofname, std::ios::binary);
+
+      if (!dst.good ()) return false;
+
+      dst.write (data (), size ());
+
+      return dst.good ();
+
+    } else {
+      /* a truncated mapping can not be read, copy the file as it is now */
+      GMimeStream * src;
+      if (is_mapped) {
+        src = g_mime_stream_file_new_for_path (fname.c_str (), "r");
+        if (src == NULL) return false;
+      } else {
+        src = source;
+        g_object_ref (src);
+      }
+
+      int fd = open (tofname.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0) {
+        g_object_unref (src);
+        return false;
+      }
+
+      GMimeStream * dst = g_mime_stream_fs_new (fd);
+
+      g_mime_stream_reset (src);
+      ssize_t r = g_mime_stream_write_to_stream (src, dst);
+      g_mime_stream_flush (dst);
+      g_mime_stream_reset (src);
+
+      g_object_unref (dst); // closes fd
+      g_object_unref (src);
+
+      return (r >= 0);
+    }
+  }
+}
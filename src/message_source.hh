@@ -0,0 +1,70 @@
+# pragma once
+
+# include <string>
+
+# include <sys/types.h>
+
+# include <gmime/gmime.h>
+
+# include "astroid.hh"
+# include "proto.hh"
+
+namespace Astroid {
+  /* the raw source of a message file
+   *
+   * the file is read into memory once and shared by the parser (the parts
+   * of the message are sub-streams of it), the raw view and saving. small
+   * files are read into a buffer, larger files are mapped so that their
+   * bytes are read from the page cache and not copied. the file descriptor
+   * is closed as soon as the file has been read or mapped, so that cached
+   * messages do not keep files open. if the file can not be read it is
+   * read through a file stream instead.
+   *
+   * a mapped file must not be truncated while it is mapped: reading the
+   * missing pages raises SIGBUS. maildir files are never modified in place
+   * (flags are changed by renaming, which does not affect the mapping), a
+   * rewritten file gets a new mtime and is dropped from the message cache.
+   * before the raw bytes are handed out the size of the file is checked,
+   * and in_memory () is false if it has shrunk.
+   */
+  class MessageSource {
+    public:
+      MessageSource (ustring fname);
+      ~MessageSource ();
+
+      ustring fname;
+
+      /* a stream of the whole message positioned at the start, or NULL if
+       * the file could not be opened. the stream is owned by the source,
+       * the memory it reads stays valid as long as the stream or any
+       * sub-stream of it is referenced. */
+      GMimeStream * stream ();
+
+      /* the bytes of the file are in memory (read or mapped) and can be
+       * accessed through data () */
+      bool in_memory ();
+      bool mapped ();
+
+      /* the file in memory, NULL if it is not in memory */
+      const char * data ();
+      size_t size ();
+
+      /* write the message to a file, returns true on success */
+      bool write_to (ustring tofname);
+
+      /* files of at least this size are mapped rather than read */
+      static const size_t map_threshold = 128 * 1024;
+
+    private:
+      GMimeStream * source = NULL;
+      bool is_in_memory = false;
+      bool is_mapped    = false;
+
+      /* the mapped file, to detect truncation */
+      dev_t map_dev;
+      ino_t map_ino;
+
+      bool truncated ();
+  };
+}
+
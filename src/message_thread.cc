@@ -10,6 +10,8 @@
 # include "log.hh"
 # include "message_thread.hh"
 # include "chunk.hh"
+# include "message_source.hh"
+# include "message_cache.hh"
 # include "utils/utils.hh"
 # include "utils/date_utils.hh"
 # include "utils/address.hh"
@@ -29,7 +31,13 @@ namespace Astroid {
     has_file   = false;
     missing_content = false;
 
-    astroid->actions->signal_message_updated ().connect (
+    connect_updated ();
+  }
+
+  void Message::connect_updated () {
+    if (updated_connection.connected ()) return;
+
+    updated_connection = astroid->actions->signal_message_updated ().connect (
         sigc::mem_fun (this, &Message::on_message_updated));
   }
 
@@ -49,7 +57,7 @@ namespace Astroid {
     load_message_from_file (fname);
   }
 
-  Message::Message (notmuch_message_t *message, int _level) : Message () {
+  Message::Message (notmuch_message_t *message, int _level, bool _connect) {
     /* The caller must make sure the message pointer
      * is valid and not destroyed while initializing */
 
@@ -57,17 +65,49 @@ namespace Astroid {
     tid = notmuch_message_get_thread_id (message);
     in_notmuch = true;
     has_file   = true;
+    missing_content = false;
     level      = _level;
 
+    if (_connect) connect_updated ();
+
     log << info << "msg: loading mid: " << mid << endl;
 
     fname = notmuch_message_get_filename (message);
     log << info << "msg: filename: " << fname << endl;
 
-    load_message_from_file (fname);
+    if (!exists (fname.c_str())) {
+      /* read the cached headers from the message we already have, rather
+       * than opening the database again */
+      log << error << "failed to open file: " << fname << ", it does not exist!" << endl;
+      log << warn << "loading cache for missing file from notmuch" << endl;
+
+      has_file = false;
+      missing_content = true;
+
+      load_notmuch_cache (message);
+    } else {
+      load_message_from_file (fname);
+    }
+
     load_tags (message);
   }
 
+  Message::Message (ustring _mid, ustring _tid, ustring _fname, int _level, bool _connect) {
+    mid   = _mid;
+    tid   = _tid;
+    fname = _fname;
+    in_notmuch = true;
+    has_file   = true;
+    missing_content = false;
+    level      = _level;
+
+    if (_connect) connect_updated ();
+
+    log << info << "msg: loading mid: " << mid << ", filename: " << fname << endl;
+
+    load_message_from_file (fname);
+  }
+
   Message::Message (GMimeMessage * _msg) {
     log << info << "msg: loading message from GMimeMessage." << endl;
     in_notmuch = false;
@@ -78,7 +118,9 @@ namespace Astroid {
   }
 
   Message::~Message () {
-    //g_object_unref (message);
+    /* reffed in load_message, the chunks do not hold references of their
+     * own and must not outlive the message. */
+    if (message != NULL) g_object_unref (message);
   }
 
   void Message::on_message_updated (Db * db, ustring _mid) {
@@ -178,21 +220,26 @@ namespace Astroid {
       }
 
     } else {
-      GMimeStream   * stream  = g_mime_stream_file_new_for_path (fname.c_str(), "r");
+      source = std::make_shared<MessageSource> (fname);
+
+      GMimeStream   * stream  = source->stream ();
       if (stream == NULL) {
         log << error << "failed to open file: " << fname << " (unspecified error)" << endl;
+        source.reset ();
         string error_s = "failed to open file: " + fname;
         throw message_error (error_s.c_str());
       }
 
+      /* the parts keep sub-streams of the source rather than copies */
       GMimeParser   * parser  = g_mime_parser_new_with_stream (stream);
+      g_mime_parser_set_persist_stream (parser, true);
 
       GMimeMessage * _message = g_mime_parser_construct_message (parser);
 
       load_message (_message);
 
-      g_object_unref (stream); // reffed from parser
-      g_object_unref (parser); // reffed from message
+      g_object_unref (_message); // reffed in load_message
+      g_object_unref (parser);   // reffed from message
     }
   }
 
@@ -200,33 +247,54 @@ namespace Astroid {
     Db db (Db::DATABASE_READ_ONLY);
     db.on_message (mid, [&](notmuch_message_t * msg)
       {
+        load_notmuch_cache (msg);
+      });
+  }
+
+  void Message::load_notmuch_cache (notmuch_message_t * msg) {
 
-        /* read header fields */
-        const char *c;
-        c = notmuch_message_get_header (msg, "From");
-        if (c != NULL) sender = ustring (c);
-        else sender = "";
+    /* read header fields */
+    const char *c;
+    c = notmuch_message_get_header (msg, "From");
+    if (c != NULL) sender = ustring (c);
+    else sender = "";
 
-        c = notmuch_message_get_header (msg, "Subject");
-        if (c != NULL) subject = ustring (c);
-        else subject = "";
+    c = notmuch_message_get_header (msg, "Subject");
+    if (c != NULL) subject = ustring (c);
+    else subject = "";
 
-        c = notmuch_message_get_header (msg, "In-Reply-To");
-        if (c != NULL) inreplyto = ustring (c);
-        else inreplyto = "";
+    c = notmuch_message_get_header (msg, "In-Reply-To");
+    if (c != NULL) inreplyto = ustring (c);
+    else inreplyto = "";
 
-        c = notmuch_message_get_header (msg, "References");
-        if (c != NULL) references = ustring (c);
-        else references = "";
+    c = notmuch_message_get_header (msg, "References");
+    if (c != NULL) references = ustring (c);
+    else references = "";
 
-        c = notmuch_message_get_header (msg, "Reply-To");
-        if (c != NULL) reply_to = ustring (c);
-        else reply_to = "";
+    c = notmuch_message_get_header (msg, "Reply-To");
+    if (c != NULL) reply_to = ustring (c);
+    else reply_to = "";
 
+    c = notmuch_message_get_header (msg, "To");
+    to_list = AddressList (ustring (c != NULL ? c : ""));
 
-        received_time = notmuch_message_get_date (msg);
+    c = notmuch_message_get_header (msg, "Cc");
+    cc_list = AddressList (ustring (c != NULL ? c : ""));
 
-      });
+    c = notmuch_message_get_header (msg, "Bcc");
+    bcc_list = AddressList (ustring (c != NULL ? c : ""));
+
+    other_to_list = AddressList ();
+    for (const char * h : { "Delivered-To", "Envelope-To", "X-Original-To" }) {
+      c = notmuch_message_get_header (msg, h);
+      if (c != NULL && strlen(c)) other_to_list += AddressList (ustring (c));
+    }
+
+    c = notmuch_message_get_header (msg, "Date");
+    if (c != NULL) date_s = ustring (c);
+    else date_s = "";
+
+    received_time = notmuch_message_get_date (msg);
   }
 
   void Message::load_message (GMimeMessage * _msg) {
@@ -279,8 +347,26 @@ namespace Astroid {
     if (c != NULL) reply_to = ustring (c);
     else reply_to = "";
 
+    to_list  = AddressList (g_mime_message_get_recipients (message, GMIME_RECIPIENT_TYPE_TO));
+    cc_list  = AddressList (g_mime_message_get_recipients (message, GMIME_RECIPIENT_TYPE_CC));
+    bcc_list = AddressList (g_mime_message_get_recipients (message, GMIME_RECIPIENT_TYPE_BCC));
+
+    other_to_list = AddressList ();
+    for (const char * h : { "Delivered-To", "Envelope-To", "X-Original-To" }) {
+      c = g_mime_object_get_header (GMIME_OBJECT(message), h);
+      if (c != NULL && strlen(c)) other_to_list += AddressList (ustring (c));
+    }
+
     g_mime_message_get_date (message, &received_time, NULL);
 
+    char * d = g_mime_message_get_date_as_string (message);
+    if (d != NULL) {
+      date_s = ustring (d);
+      g_free (d);
+    } else {
+      date_s = "";
+    }
+
     root = refptr<Chunk>(new Chunk (g_mime_message_get_mime_part (message)));
 
     g_object_ref (message);  // TODO: a little bit at loss here -> change to
@@ -395,25 +481,7 @@ namespace Astroid {
   }
 
   ustring Message::date () {
-    if (missing_content) {
-      ustring s;
-
-      Db db (Db::DATABASE_READ_ONLY);
-      db.on_message (mid, [&](notmuch_message_t * msg)
-        {
-          /* read header field */
-          const char *c;
-
-          c = notmuch_message_get_header (msg, "Date");
-
-          if (c != NULL) s = ustring (c);
-          else s = "";
-        });
-
-      return s;
-    } else {
-      return ustring (g_mime_message_get_date_as_string (message));
-    }
+    return date_s;
   }
 
   ustring Message::pretty_date () {
@@ -424,141 +492,24 @@ namespace Astroid {
     return Date::pretty_print_verbose (received_time, include_short);
   }
 
-  InternetAddressList * Message::to () {
-    if (missing_content) {
-      ustring s;
-
-      Db db (Db::DATABASE_READ_ONLY);
-      db.on_message (mid, [&](notmuch_message_t * msg)
-        {
-          /* read header field */
-          const char *c;
-
-          c = notmuch_message_get_header (msg, "To");
-
-          if (c != NULL) s = ustring (c);
-          else s = "";
-        });
-
-      log << debug << "message: cached value: " << s << endl;
-      if (s.empty ()) {
-        return internet_address_list_new ();
-      } else {
-        return internet_address_list_parse_string (s.c_str());
-      }
-    } else {
-      return g_mime_message_get_recipients (message, GMIME_RECIPIENT_TYPE_TO);
-    }
+  AddressList Message::to () {
+    return to_list;
   }
 
-  InternetAddressList * Message::cc () {
-    if (missing_content) {
-      ustring s;
-
-      Db db (Db::DATABASE_READ_ONLY);
-      db.on_message (mid, [&](notmuch_message_t * msg)
-        {
-          /* read header field */
-          const char *c;
-
-          c = notmuch_message_get_header (msg, "Cc");
-
-          if (c != NULL) s = ustring (c);
-          else s = "";
-        });
-
-      log << debug << "message: cached value: " << s << endl;
-      if (s.empty ()) {
-        return internet_address_list_new ();
-      } else {
-        return internet_address_list_parse_string (s.c_str());
-      }
-    } else {
-      return g_mime_message_get_recipients (message, GMIME_RECIPIENT_TYPE_CC);
-    }
+  AddressList Message::cc () {
+    return cc_list;
   }
 
-  InternetAddressList * Message::bcc () {
-    if (missing_content) {
-      ustring s;
-
-      Db db (Db::DATABASE_READ_ONLY);
-      db.on_message (mid, [&](notmuch_message_t * msg)
-        {
-          /* read header field */
-          const char *c;
-
-          c = notmuch_message_get_header (msg, "Bcc");
-
-          if (c != NULL) s = ustring (c);
-          else s = "";
-        });
-
-      log << debug << "message: cached value: " << s << endl;
-      if (s.empty ()) {
-        return internet_address_list_new ();
-      } else {
-        return internet_address_list_parse_string (s.c_str());
-      }
-    } else {
-      return g_mime_message_get_recipients (message, GMIME_RECIPIENT_TYPE_BCC);
-    }
+  AddressList Message::bcc () {
+    return bcc_list;
   }
 
-  InternetAddressList * Message::other_to () {
-    InternetAddressList * ret = internet_address_list_new ();
-    if (missing_content) {
-
-      Db db (Db::DATABASE_READ_ONLY);
-      db.on_message (mid, [&](notmuch_message_t * msg) {
-          const char *c;
-          c = notmuch_message_get_header (msg, "Delivered-To");
-          if (c != NULL && strlen(c)) {
-            ustring s = c;
-            internet_address_list_append(ret, internet_address_list_parse_string (s.c_str()));
-          }
-
-          c = notmuch_message_get_header (msg, "Envelope-To");
-          if (c != NULL && strlen(c)) {
-            ustring s = c;
-            internet_address_list_append(ret, internet_address_list_parse_string (s.c_str()));
-          }
-
-          c = notmuch_message_get_header (msg, "X-Original-To");
-          if (c != NULL && strlen(c)) {
-            ustring s = c;
-            internet_address_list_append(ret, internet_address_list_parse_string (s.c_str()));
-          }
-          });
-
-    } else {
-
-      const char *c;
-      c = g_mime_object_get_header (GMIME_OBJECT(message), "Delivered-To");
-      if (c != NULL && strlen(c)) {
-        ustring s = c;
-        internet_address_list_append(ret, internet_address_list_parse_string (s.c_str()));
-      }
-
-      c = g_mime_object_get_header (GMIME_OBJECT(message), "Envelope-To");
-      if (c != NULL && strlen(c)) {
-        ustring s = c;
-        internet_address_list_append(ret, internet_address_list_parse_string (s.c_str()));
-      }
-
-      c = g_mime_object_get_header (GMIME_OBJECT(message), "X-Original-To");
-      if (c != NULL && strlen(c)) {
-        ustring s = c;
-        internet_address_list_append(ret, internet_address_list_parse_string (s.c_str()));
-      }
-
-    }
-
-    return ret;
+  AddressList Message::other_to () {
+    return other_to_list;
   }
 
   AddressList Message::all_to_from () {
-    return ( AddressList(to()) + AddressList(cc()) + AddressList(bcc()) + AddressList(other_to()) + Address(sender) );
+    return ( to_list + cc_list + bcc_list + other_to_list + Address(sender) );
   }
 
   ustring Message::get_filename (ustring appendix) {
@@ -662,7 +613,12 @@ namespace Astroid {
     tofname = ustring (to.c_str());
     log << info << "msg: saving to: " << tofname << endl;
 
-    if (has_file)
+    if (source) {
+      if (!source->write_to (tofname)) {
+        log << error << "msg: failed writing to: " << tofname << endl;
+      }
+
+    } else if (has_file)
     {
       std::ifstream src (fname, ios::binary);
       std::ofstream dst (tofname, ios::binary);
@@ -695,6 +651,15 @@ namespace Astroid {
   refptr<Glib::ByteArray> Message::raw_contents () {
     time_t t0 = clock ();
 
+    if (source && source->in_memory ()) {
+      auto data = Glib::ByteArray::create ();
+      data->append (reinterpret_cast<const guint8 *> (source->data ()), source->size ());
+
+      log << info << "message: contents: mapped " << data->size () << " bytes in " << ( (clock () - t0) * 1000.0 / CLOCKS_PER_SEC ) << " ms." << endl;
+
+      return data;
+    }
+
     // https://github.com/skx/lumail/blob/master/util/attachments.c
 
     GMimeStream * mem = g_mime_stream_mem_new ();
@@ -776,7 +741,7 @@ namespace Astroid {
 
 
               reply = notmuch_messages_get (replies);
-              messages.push_back (refptr<Message> (new Message (reply, lvl)));
+              messages.push_back (astroid->message_cache->load (reply, lvl));
 
               add_replies (reply, lvl + 1);
 
@@ -790,7 +755,7 @@ namespace Astroid {
 
           message = notmuch_messages_get (qmessages);
 
-          messages.push_back (refptr<Message>(new Message (message, level)));
+          messages.push_back (astroid->message_cache->load (message, level));
 
           add_replies (message, level + 1);
 
@@ -1,6 +1,7 @@
 # pragma once
 
 # include <vector>
+# include <memory>
 
 # include <notmuch.h>
 # include <gmime/gmime.h>
@@ -15,7 +16,12 @@ namespace Astroid {
       Message ();
       Message (ustring _fname);
       Message (ustring _mid, ustring _fname);
-      Message (notmuch_message_t *, int _level);
+      Message (notmuch_message_t *, int _level, bool _connect = true);
+
+      /* a message in the database with the fields already read from it:
+       * the file is parsed without opening the database (unless it is
+       * missing), tags must be set by the caller. */
+      Message (ustring _mid, ustring _tid, ustring _fname, int _level, bool _connect = true);
       Message (GMimeMessage *);
       ~Message ();
 
@@ -32,22 +38,35 @@ namespace Astroid {
       void load_message_from_file (ustring);
       void load_message (GMimeMessage *);
       void load_notmuch_cache ();
+      void load_notmuch_cache (notmuch_message_t *);
       void load_tags (Db *);
       void load_tags (notmuch_message_t *);
 
       void on_message_updated (Db *, ustring);
       void refresh (Db *);
 
-      GMimeMessage * message;
+      /* connect to the message updated signal, this is done on
+       * construction unless the message is loaded on another thread: then
+       * it must be done on the gui thread when the message is handed over.
+       * connecting a message that is already connected does nothing. */
+      void connect_updated ();
+
+      GMimeMessage * message = NULL;
+
+      /* the mapped message file, shared by the parsed message, the raw
+       * view and saving. empty if the message was not loaded from a file. */
+      std::shared_ptr<MessageSource> source;
       refptr<Chunk>     root;
       int level = 0;
 
       ustring sender;
       ustring subject;
-      InternetAddressList * to ();
-      InternetAddressList * cc ();
-      InternetAddressList * bcc ();
-      InternetAddressList * other_to ();
+      /* the address headers and the date are read once when the message
+       * is loaded, from the file or from the notmuch cache */
+      AddressList to ();
+      AddressList cc ();
+      AddressList bcc ();
+      AddressList other_to ();
 
       /* address list with all addresses in all headers beginning with to
        * and ending with from */
@@ -86,6 +105,14 @@ namespace Astroid {
       type_signal_message_changed signal_message_changed ();
 
     protected:
+      sigc::connection updated_connection;
+
+      AddressList to_list;
+      AddressList cc_list;
+      AddressList bcc_list;
+      AddressList other_to_list;
+      ustring     date_s;
+
       void emit_message_changed (Db *, MessageChangedEvent);
       type_signal_message_changed m_signal_message_changed;
   };
@@ -2,6 +2,8 @@
 # include "log.hh"
 
 # include "log_view.hh"
+# include "message_cache.hh"
+# include "thread_cache.hh"
 
 using namespace std;
 
@@ -108,6 +110,21 @@ namespace Astroid {
           return true;
         });
 
+    keys.register_key ("s",
+        "log.cache_statistics",
+        "Show cache statistics",
+        [&] (Key) {
+          log << info << astroid->message_cache->stats () << endl;
+
+          if (astroid->thread_cache->enabled) {
+            log << info << ustring::compose ("tc: %1 hits, %2 misses",
+                astroid->thread_cache->hits,
+                astroid->thread_cache->misses) << endl;
+          }
+
+          return true;
+        });
+
     keys.loghandle = false;
   }
 
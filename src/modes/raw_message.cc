@@ -5,6 +5,7 @@
 # include "astroid.hh"
 # include "raw_message.hh"
 # include "message_thread.hh"
+# include "message_source.hh"
 # include "log.hh"
 
 using namespace std;
@@ -99,29 +100,19 @@ namespace Astroid {
 
     /* load message source */
     log << info << "rm: loading message from file: " << fname << endl;
-    ifstream f (fname);
+    MessageSource source (fname);
 
-    refptr<Gtk::TextBuffer> buf = tv.get_buffer ();
-    stringstream s;
-    s << f.rdbuf ();
-    std::string _in = s.str ();
+    if (source.in_memory ()) {
+      set_text (source.data (), source.size ());
+    } else {
+      ifstream f (fname);
 
-    int len    = _in.size ();
-    gchar * in = (gchar *) _in.c_str ();
+      stringstream s;
+      s << f.rdbuf ();
+      std::string _in = s.str ();
 
-    /* convert */
-    gsize read, written;
-    GError * err = NULL;
-    gchar * out = g_convert_with_fallback (in, len, "UTF-8", "ASCII", NULL,
-                                           &read, &written, &err);
-
-    if (out != NULL) {
-      buf->set_text ( out, out+written);
-    } else {
-      log << error << "raw: could not convert: " << in << endl;
+      set_text (_in.c_str (), _in.size ());
     }
-
-    g_free (out);
   }
 
   RawMessage::RawMessage (MainWindow *mw, refptr<Message> _msg) : RawMessage (mw) {
@@ -132,11 +123,17 @@ namespace Astroid {
     /* load message source */
     log << info << "rm: loading message.. " << endl;
 
-    refptr<Gtk::TextBuffer> buf = tv.get_buffer ();
+    if (msg->source && msg->source->in_memory ()) {
+      /* read straight from the mapped file */
+      set_text (msg->source->data (), msg->source->size ());
+    } else {
+      auto c = msg->raw_contents ();
+      set_text ((const char *) c->get_data (), c->size ());
+    }
+  }
 
-    auto c = msg->raw_contents ();
-    gchar * in = (gchar *) c->get_data ();
-    int len    = c->size ();
+  void RawMessage::set_text (const char * in, size_t len) {
+    refptr<Gtk::TextBuffer> buf = tv.get_buffer ();
 
     /* convert */
     gsize read, written;
@@ -147,7 +144,7 @@ namespace Astroid {
     if (out != NULL) {
       buf->set_text ( out, out+written);
     } else {
-      log << error << "raw: could not convert: " << in << endl;
+      log << error << "raw: could not convert message." << endl;
     }
 
     g_free (out);
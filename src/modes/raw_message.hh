@@ -22,6 +22,8 @@ namespace Astroid {
       bool delete_on_close = false;
       bfs::path fname;
 
+      void set_text (const char *, size_t);
+
       Gtk::ScrolledWindow scroll;
       Gtk::TextView       tv;
   };
@@ -176,9 +176,7 @@ namespace Astroid {
 
       auto msg_to = Address(to);
       if (accounts->is_me(msg_to)) {
-        AddressList al (msg->to());
-
-        to = al.str ();
+        to = msg->to ().str ();
       }
 
       cc = "";
@@ -199,17 +197,17 @@ namespace Astroid {
         al += msg_from;
       }
 
-      al += AddressList (msg->to());
+      al += msg->to ();
 
       al.remove_me ();
 
       to = al.str ();
 
-      AddressList ac (msg->cc ());
+      AddressList ac = msg->cc ();
       ac.remove_me ();
       cc = ac.str ();
 
-      AddressList acc (msg->bcc ());
+      AddressList acc = msg->bcc ();
       acc.remove_me ();
       bcc = acc.str ();
     }
@@ -360,11 +360,14 @@ namespace Astroid {
     SavedSearches::m_reload.connect (
         sigc::mem_fun (this, &SavedSearches::reload));
 
-    astroid->actions->signal_thread_changed ().connect (
-        sigc::mem_fun (this, &SavedSearches::on_thread_changed));
+    astroid->actions->signal_threads_changed ().connect (
+        sigc::mem_fun (this, &SavedSearches::on_threads_changed));
 
     astroid->actions->signal_refreshed ().connect (
         sigc::mem_fun (this, &SavedSearches::reload));
+
+    astroid->actions->signal_refreshed_lastmod ().connect (
+        sigc::mem_fun (this, &SavedSearches::on_refreshed_lastmod));
   }
 
   void SavedSearches::on_my_row_activated (
@@ -447,7 +450,11 @@ namespace Astroid {
     row[m_columns.m_col_total_messages] = ustring::compose ("(total: %1)", total_messages);
   }
 
-  void SavedSearches::on_thread_changed (Db *, ustring) {
+  void SavedSearches::on_threads_changed (Db *, std::vector<ustring>) {
+    refresh_stats ();
+  }
+
+  void SavedSearches::on_refreshed_lastmod (Db *, unsigned long, unsigned long) {
     refresh_stats ();
   }
 
@@ -30,7 +30,8 @@ namespace Astroid {
 
       static Glib::Dispatcher m_reload;
 
-      void on_thread_changed (Db *, ustring);
+      void on_threads_changed (Db *, std::vector<ustring>);
+      void on_refreshed_lastmod (Db *, unsigned long, unsigned long);
       void load_startup_queries ();
       void load_saved_searches ();
       void add_query (ustring, ustring, bool saved = false, bool history = false);
@@ -4,13 +4,20 @@
 
 # include "query_loader.hh"
 # include "thread_index_list_view.hh"
+# include "thread_index_list_cell_renderer.hh"
 # include "config.hh"
 # include "actions/action_manager.hh"
+# include "thread_cache.hh"
 
 # include <thread>
 # include <queue>
 # include <mutex>
 # include <functional>
+# include <set>
+# include <unordered_set>
+# include <algorithm>
+# include <atomic>
+# include <condition_variable>
 
 # include <notmuch.h>
 
@@ -36,7 +43,11 @@ namespace Astroid {
       sort = NOTMUCH_SORT_NEWEST_FIRST;
     }
 
+    loader_threads = astroid->config ().get<int> ("thread_index.loader_threads");
+    if (loader_threads < 1) loader_threads = 1;
+
     loaded_threads = 0;
+    total_threads = 0;
     total_messages = 0;
     unread_messages = 0;
     run = false;
@@ -47,11 +58,14 @@ namespace Astroid {
     make_stats.connect (
         sigc::mem_fun (this, &QueryLoader::refresh_stats));
 
-    astroid->actions->signal_thread_changed ().connect (
-        sigc::mem_fun (this, &QueryLoader::on_thread_changed));
+    astroid->actions->signal_threads_changed ().connect (
+        sigc::mem_fun (this, &QueryLoader::on_threads_changed));
 
     astroid->actions->signal_refreshed ().connect (
         sigc::mem_fun (this, &QueryLoader::on_refreshed));
+
+    astroid->actions->signal_refreshed_lastmod ().connect (
+        sigc::mem_fun (this, &QueryLoader::on_refreshed_lastmod));
   }
 
   QueryLoader::~QueryLoader () {
@@ -63,6 +77,8 @@ namespace Astroid {
   void QueryLoader::start (ustring q) {
     std::lock_guard<std::mutex> lk (loader_m);
     query = q;
+    cache_key = ThreadCache::query_key (query, sort, Db::excluded_tags);
+    list_store->cache_key = cache_key;
     run = true;
     loader_thread = std::thread (&QueryLoader::loader, this);
   }
@@ -80,6 +96,9 @@ namespace Astroid {
     stop ();
     std::lock_guard<std::mutex> lk (to_list_m);
     list_store->clear ();
+    list_store->clear_cache ();
+    list_view->renderer->invalidate_rendered ();
+    thread_rows.clear ();
 
     while (!to_list_store.empty ())
       to_list_store.pop ();
@@ -139,9 +158,35 @@ namespace Astroid {
 
     Db db (Db::DATABASE_READ_ONLY);
 
+    /* the number of threads is not known until the first rows have been
+     * queued, see count_threads () */
+    total_threads = 0;
+    loaded_threads = 0; // incremented in list_adder
+
+    /* drop cached summaries for threads changed since last load */
+    astroid->thread_cache->validate (&db);
+
+    if (loader_threads > 1) {
+      load_parallel (db);
+    } else {
+      load_serial (db);
+    }
+
+    run = false;
+
+    if (!in_destructor)
+      stats_ready.emit (); // update loading status
+
+    // catch any remaining entries
+    if (!in_destructor)
+      queue_has_data.emit ();
+  }
+
+  void QueryLoader::load_serial (Db & db) {
     /* set up query */
     notmuch_query_t * nmquery;
     notmuch_threads_t * threads;
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
 
     nmquery = notmuch_query_create (db.nm_db, query.c_str ());
     for (ustring & t : db.excluded_tags) {
@@ -152,7 +197,6 @@ namespace Astroid {
     notmuch_query_set_sort (nmquery, sort);
 
     /* slow */
-    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
 # ifdef HAVE_QUERY_THREADS_ST
     st = notmuch_query_search_threads_st (nmquery, &threads);
 # else
@@ -164,7 +208,6 @@ namespace Astroid {
       run = false;
     }
 
-    loaded_threads = 0; // incremented in list_adder
     int i = 0;
 
     for (;
@@ -179,13 +222,19 @@ namespace Astroid {
         throw database_error ("ql: could not get thread (is NULL)");
       }
 
-      NotmuchThread *t = new NotmuchThread (thread);
+      /* only the cheap fields are loaded here, the subject and authors are
+       * loaded when the thread is displayed. */
+      refptr<NotmuchThread> t = astroid->thread_cache->get (cache_key, notmuch_thread_get_thread_id (thread));
+
+      if (!t) {
+        t = refptr<NotmuchThread> (new NotmuchThread (thread, false));
+      }
 
       notmuch_thread_destroy (thread);
 
       std::unique_lock<std::mutex> lk (to_list_m);
 
-      to_list_store.push (refptr<NotmuchThread>(t));
+      to_list_store.push (t);
 
       lk.unlock ();
 
@@ -194,37 +243,263 @@ namespace Astroid {
       if ((i % 100) == 0) {
         if (run && !in_destructor)
           queue_has_data.emit ();
+
+        /* counting the threads iterates all matching messages, it is done
+         * once the first rows are on their way to the list. */
+        if (i == 100) count_threads (db);
+      }
+
+      if ((i % 2000) == 0) {
+        if (run && !in_destructor)
+          stats_ready.emit (); // update loading progress
       }
     }
 
+    /* all threads have been seen */
+    if (run) total_threads = i;
+
     /* closing query */
     notmuch_threads_destroy (threads);
     notmuch_query_destroy (nmquery);
+  }
 
-    run = false;
+  void QueryLoader::count_threads (Db & db) {
+    /* count threads for progress */
+    notmuch_query_t * nmquery = notmuch_query_create (db.nm_db, query.c_str ());
+    for (ustring & t : db.excluded_tags) {
+      notmuch_query_add_tag_exclude (nmquery, t.c_str());
+    }
+    notmuch_query_set_omit_excluded (nmquery, NOTMUCH_EXCLUDE_TRUE);
 
-    if (!in_destructor)
-      stats_ready.emit (); // update loading status
+    unsigned int c = 0;
+# ifdef HAVE_QUERY_COUNT_THREADS_ST
+    notmuch_status_t st = notmuch_query_count_threads_st (nmquery, &c);
+    if (st != NOTMUCH_STATUS_SUCCESS) c = 0;
+# else
+    c = notmuch_query_count_threads (nmquery);
+# endif
+    notmuch_query_destroy (nmquery);
 
-    // catch any remaining entries
-    if (!in_destructor)
-      queue_has_data.emit ();
+    total_threads = c;
+
+    if (run && !in_destructor)
+      stats_ready.emit (); // update loading progress
+  }
+
+  void QueryLoader::load_parallel (Db & db) {
+    /* the threads are loaded in chunks of thread ids by a number of workers,
+     * each with its own read-only db. the chunks are queued in order so that
+     * the sort order of the query is kept.
+     *
+     * the thread ids are first collected in sort order from the matching
+     * messages: this is the same order notmuch sorts threads in. each chunk
+     * is returned in the order of its ids. */
+    notmuch_query_t * nmquery = notmuch_query_create (db.nm_db, query.c_str ());
+    for (ustring & t : db.excluded_tags) {
+      notmuch_query_add_tag_exclude (nmquery, t.c_str());
+    }
+
+    notmuch_query_set_omit_excluded (nmquery, NOTMUCH_EXCLUDE_TRUE);
+    notmuch_query_set_sort (nmquery, sort);
+
+    notmuch_messages_t * messages;
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+# ifdef HAVE_QUERY_THREADS_ST
+    st = notmuch_query_search_messages_st (nmquery, &messages);
+# else
+    messages = notmuch_query_search_messages (nmquery);
+# endif
+
+    if (st != NOTMUCH_STATUS_SUCCESS) {
+      log << error << "ql: could not get messages for query: " << query << endl;
+      notmuch_query_destroy (nmquery);
+      return;
+    }
+
+    std::vector<ustring> thread_ids;
+    std::unordered_set<std::string> seen;
+
+    for (;
+         run && notmuch_messages_valid (messages);
+         notmuch_messages_move_to_next (messages)) {
+
+      notmuch_message_t * message = notmuch_messages_get (messages);
+      const char * tid = notmuch_message_get_thread_id (message);
+
+      if (tid != NULL && seen.insert (tid).second) {
+        thread_ids.push_back (tid);
+      }
+
+      notmuch_message_destroy (message);
+    }
+
+    notmuch_messages_destroy (messages);
+    notmuch_query_destroy (nmquery);
+
+    seen.clear ();
+
+    total_threads = thread_ids.size ();
+
+    const unsigned int chunk_size = 250;
+    unsigned int chunks = (thread_ids.size () + chunk_size - 1) / chunk_size;
+
+    std::vector<std::vector<refptr<NotmuchThread>>> results (chunks);
+    std::vector<bool>         done (chunks, false);
+    std::mutex                done_m;
+    std::condition_variable   done_cv;
+    std::atomic<unsigned int> next_chunk (0);
+
+    auto worker = [&] () {
+      Db wdb (Db::DATABASE_READ_ONLY);
+
+      while (run) {
+        unsigned int c = next_chunk++;
+        if (c >= chunks) break;
+
+        auto begin = thread_ids.cbegin () + c * chunk_size;
+        auto end   = thread_ids.cbegin () + std::min ((unsigned int) thread_ids.size (), (c + 1) * chunk_size);
+
+        std::vector<refptr<NotmuchThread>> res = load_chunk (wdb, begin, end);
+
+        std::lock_guard<std::mutex> lk (done_m);
+        results[c] = std::move (res);
+        done[c] = true;
+        done_cv.notify_all ();
+      }
+
+      wdb.close ();
+
+      /* wake up the merger in case we were stopped */
+      std::lock_guard<std::mutex> lk (done_m);
+      done_cv.notify_all ();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < std::min ((unsigned int) loader_threads, chunks); w++) {
+      workers.push_back (std::thread (worker));
+    }
+
+    /* merge chunks in order */
+    for (unsigned int c = 0; c < chunks; c++) {
+      std::unique_lock<std::mutex> lk (done_m);
+      done_cv.wait (lk, [&] { return done[c] || !run; });
+
+      if (!done[c]) break;
+
+      std::vector<refptr<NotmuchThread>> res = std::move (results[c]);
+      lk.unlock ();
+
+      std::unique_lock<std::mutex> tlk (to_list_m);
+      for (auto &t : res) to_list_store.push (t);
+      tlk.unlock ();
+
+      if (run && !in_destructor)
+        queue_has_data.emit ();
+
+      if ((c % 8) == 7) {
+        if (run && !in_destructor)
+          stats_ready.emit (); // update loading progress
+      }
+    }
+
+    for (auto &w : workers) w.join ();
+  }
+
+  std::vector<refptr<NotmuchThread>> QueryLoader::load_chunk (
+      Db & db,
+      std::vector<ustring>::const_iterator begin,
+      std::vector<ustring>::const_iterator end)
+  {
+    /* threads found in the summary cache are used as they are, the rest
+     * are loaded with one query. the result is in the order of the ids. */
+    std::vector<refptr<NotmuchThread>> res (end - begin);
+    std::unordered_map<std::string, unsigned int> misses;
+
+    ustring match;
+    for (auto it = begin; it != end; it++) {
+      refptr<NotmuchThread> t = astroid->thread_cache->get (cache_key, *it);
+
+      if (t) {
+        res[it - begin] = t;
+      } else {
+        misses[*it] = it - begin;
+
+        if (!match.empty ()) match += " OR ";
+        match += "thread:" + *it;
+      }
+    }
+
+    if (!misses.empty ()) {
+      ustring query_s = "(" + query + ") AND (" + match + ")";
+
+      notmuch_query_t * q = notmuch_query_create (db.nm_db, query_s.c_str ());
+      for (ustring & t : db.excluded_tags) {
+        notmuch_query_add_tag_exclude (q, t.c_str());
+      }
+
+      notmuch_query_set_omit_excluded (q, NOTMUCH_EXCLUDE_TRUE);
+      notmuch_query_set_sort (q, NOTMUCH_SORT_UNSORTED);
+
+      notmuch_threads_t * threads;
+      notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+# ifdef HAVE_QUERY_THREADS_ST
+      st = notmuch_query_search_threads_st (q, &threads);
+# else
+      threads = notmuch_query_search_threads (q);
+# endif
+
+      if (st == NOTMUCH_STATUS_SUCCESS) {
+        for (;
+             run && notmuch_threads_valid (threads);
+             notmuch_threads_move_to_next (threads)) {
+
+          notmuch_thread_t * thread = notmuch_threads_get (threads);
+          refptr<NotmuchThread> t (new NotmuchThread (thread, false));
+          notmuch_thread_destroy (thread);
+
+          auto fnd = misses.find (t->thread_id);
+          if (fnd != misses.end ()) {
+            res[fnd->second] = t;
+          }
+        }
+
+        notmuch_threads_destroy (threads);
+      }
+
+      notmuch_query_destroy (q);
+    }
+
+    /* drop threads that could not be loaded */
+    res.erase (std::remove_if (res.begin (), res.end (),
+          [] (const refptr<NotmuchThread> & t) { return !t; }), res.end ());
+
+    return res;
   }
 
   void QueryLoader::to_list_adder () {
+    /* the rows are added in bounded batches, the remaining rows are added
+     * from an idle handler so that drawing and input are handled in
+     * between. */
+    if (add_rows () && !rows_idle.connected ()) {
+      rows_idle = Glib::signal_idle ().connect (
+          sigc::mem_fun (this, &QueryLoader::add_rows));
+    }
+  }
+
+  bool QueryLoader::add_rows () {
     std::lock_guard<std::mutex> lk (to_list_m);
 
-    while (!to_list_store.empty ()) {
+    unsigned int n = 0;
+
+    while (!to_list_store.empty () && n < rows_per_batch) {
       refptr<NotmuchThread> t = to_list_store.front ();
       to_list_store.pop ();
 
-      auto iter = list_store->append ();
-      Gtk::ListStore::Row row = *iter;
+      /* already added by update_threads while it was queued */
+      if (thread_rows.count (t->thread_id)) continue;
 
-      row[list_store->columns.newest_date] = t->newest_date;
-      row[list_store->columns.oldest_date] = t->oldest_date;
-      row[list_store->columns.thread_id]   = t->thread_id;
-      row[list_store->columns.thread]      = t;
+      add_thread (t);
+      n++;
 
       if (loaded_threads == 0) {
         if (!in_destructor)
@@ -237,10 +512,57 @@ namespace Astroid {
         log << debug << "ql: loaded " << loaded_threads << " threads." << endl;
       }
     }
+
+    return !to_list_store.empty ();
+  }
+
+  void QueryLoader::drain_rows () {
+    /* add all queued rows now, so that updates see them */
+    rows_idle.disconnect ();
+    while (add_rows ()) ;
+  }
+
+  Gtk::TreeIter QueryLoader::add_thread (refptr<NotmuchThread> t, bool prepend) {
+    auto iter = (prepend ? list_store->prepend () : list_store->append ());
+    Gtk::ListStore::Row row = *iter;
+
+    row[list_store->columns.newest_date] = t->newest_date;
+    row[list_store->columns.oldest_date] = t->oldest_date;
+    row[list_store->columns.thread_id]   = t->thread_id;
+    row[list_store->columns.unread]      = t->unread;
+
+    list_store->keep (t);
+
+    thread_rows[t->thread_id] = iter;
+
+    return iter;
+  }
+
+  void QueryLoader::erase_thread (Gtk::TreeIter iter) {
+    Gtk::ListStore::Row row = *iter;
+    ustring thread_id = row[list_store->columns.thread_id];
+
+    thread_rows.erase (thread_id);
+    list_store->erase (iter);
+  }
+
+  Gtk::TreeIter QueryLoader::find_thread (ustring thread_id) {
+    auto fnd = thread_rows.find (thread_id);
+
+    if (fnd != thread_rows.end ()) {
+      return fnd->second;
+    } else {
+      return Gtk::TreeIter ();
+    }
   }
 
   bool QueryLoader::loading () {
-    return run;
+    /* rows may still be queued for the list store after the loader thread
+     * has finished */
+    if (run || rows_idle.connected ()) return true;
+
+    std::lock_guard<std::mutex> lk (to_list_m);
+    return !to_list_store.empty ();
   }
 
   /***************
@@ -253,122 +575,192 @@ namespace Astroid {
     reload ();
   }
 
-  void QueryLoader::on_thread_changed (Db * db, ustring thread_id) {
+  void QueryLoader::on_refreshed_lastmod (Db * db, unsigned long from, unsigned long to) {
     if (in_destructor) return;
 
-    log << info << "ql (" << id << "): " << query << ", got changed thread signal: " << thread_id << endl;
+    if (loading ()) {
+      /* the loader may or may not have seen the changes */
+      log << info << "ql (" << id << "): got refreshed lastmod signal while loading, reloading." << endl;
+      reload ();
+      return;
+    }
 
-    /* we now have three options:
-     * - a new thread has been added (unlikely)
-     * - a thread has been deleted (kind of likely)
-     * - a thread has been updated (most likely)
-     *
-     * none of them needs to affect the threads that match the query in this
-     * list.
-     *
-     */
+    log << info << "ql (" << id << "): " << query << ", updating threads in lastmod: " << from << ".." << to << endl;
 
-    time_t t0 = clock ();
+    /* collect the threads with changed messages first: a changed message
+     * need not match the query for its thread to still be in it (e.g. a
+     * new reply without the inbox tag in an inbox thread), so membership
+     * is decided by the thread level query in on_threads_changed. */
+    ustring lastmod = ustring::compose ("lastmod:%1..%2", from, to);
 
-    Gtk::TreePath path;
-    Gtk::TreeIter fwditer;
+    notmuch_query_t * nmquery = notmuch_query_create (db->nm_db, lastmod.c_str ());
+    notmuch_messages_t * messages;
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+# ifdef HAVE_QUERY_THREADS_ST
+    st = notmuch_query_search_messages_st (nmquery, &messages);
+# else
+    messages = notmuch_query_search_messages (nmquery);
+# endif
 
-    /* forward iterating is much faster than going backwards:
-     * https://developer.gnome.org/gtkmm/3.11/classGtk_1_1TreeIter.html
-     */
+    if (st != NOTMUCH_STATUS_SUCCESS) {
+      log << error << "ql: could not get changed messages, reloading: " << query << endl;
+      notmuch_query_destroy (nmquery);
+      reload ();
+      return;
+    }
 
-    bool found = false;
-    bool changed = false;
-    fwditer = list_store->get_iter ("0");
+    std::vector<ustring> changed;
+    std::unordered_set<std::string> seen;
 
-    Gtk::ListStore::Row row;
+    for (; notmuch_messages_valid (messages);
+           notmuch_messages_move_to_next (messages)) {
+      notmuch_message_t * message = notmuch_messages_get (messages);
+      const char * tid = notmuch_message_get_thread_id (message);
 
-    while (fwditer) {
+      if (tid != NULL && seen.insert (tid).second) {
+        changed.push_back (tid);
+      }
 
-      row = *fwditer;
+      notmuch_message_destroy (message);
+    }
 
-      if (row[list_store->columns.thread_id] == thread_id) {
-        found = true;
-        break;
+    notmuch_messages_destroy (messages);
+    notmuch_query_destroy (nmquery);
+
+    on_threads_changed (db, changed);
+  }
+
+  void QueryLoader::on_threads_changed (Db * db, std::vector<ustring> thread_ids) {
+    if (in_destructor) return;
+
+    log << info << "ql (" << id << "): " << query << ", got changed threads signal: " << thread_ids.size () << " threads." << endl;
+
+    /* queued threads must have rows before they can be updated or
+     * removed */
+    drain_rows ();
+
+    /* keep the query at a sane length for very large batches */
+    const unsigned int threads_per_query = 100;
+
+    for (unsigned int i = 0; i < thread_ids.size (); i += threads_per_query) {
+      std::vector<ustring> chunk (thread_ids.begin () + i,
+          thread_ids.begin () + std::min ((unsigned int) thread_ids.size (), i + threads_per_query));
+
+      ustring match;
+      for (auto &tid : chunk) {
+        if (!match.empty ()) match += " OR ";
+        match += "thread:" + tid;
       }
 
-      fwditer++;
+      update_threads (db, "(" + match + ")", chunk);
     }
+  }
 
-    /* test if thread is in the current query */
-    bool in_query = db->thread_in_query (query, thread_id);
+  void QueryLoader::update_threads (Db * db, ustring match, std::vector<ustring> changed) {
+    /* update, add or remove the `changed` threads, `match` is the query
+     * matching exactly these threads. */
+    time_t t0 = clock ();
 
-    if (found) {
-      /* thread has either been updated or deleted from current query */
-      log << debug << "ql: updated: found thread in: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms." << endl;
+    /* threads in the query that have been changed: these have either
+     * been updated or added to the query. */
+    std::set<ustring> in_query;
+    std::vector<refptr<NotmuchThread>> added;
+    unsigned int updated = 0, deleted = 0;
 
-      if (in_query) {
-        /* updated */
-        log << debug << "ql: updated" << endl;
-        refptr<NotmuchThread> thread = row[list_store->columns.thread];
-        thread->refresh (db);
-        row[list_store->columns.newest_date] = thread->newest_date;
-        row[list_store->columns.oldest_date] = thread->oldest_date;
+    ustring query_s = "(" + query + ") AND " + match;
+    notmuch_query_t * nmquery = notmuch_query_create (db->nm_db, query_s.c_str ());
+    for (ustring & t : db->excluded_tags) {
+      notmuch_query_add_tag_exclude (nmquery, t.c_str());
+    }
+    notmuch_query_set_omit_excluded (nmquery, NOTMUCH_EXCLUDE_TRUE);
+    notmuch_query_set_sort (nmquery, sort);
 
-      } else {
-        /* deleted */
-        log << debug << "ql: deleted" << endl;
-        path = list_store->get_path (fwditer);
-        list_store->erase (fwditer);
-      }
+    notmuch_threads_t * threads;
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+# ifdef HAVE_QUERY_THREADS_ST
+    st = notmuch_query_search_threads_st (nmquery, &threads);
+# else
+    threads = notmuch_query_search_threads (nmquery);
+# endif
 
-      changed = true;
+    if (st != NOTMUCH_STATUS_SUCCESS) {
+      log << error << "ql: could not get changed threads for query, reloading: " << query << endl;
+      notmuch_query_destroy (nmquery);
+      reload ();
+      return;
+    }
 
-    } else {
-      /* thread has possibly been added to the current query */
-      log << debug << "ql: updated: did not find thread, time used: " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms." << endl;
-      if (in_query) {
-        log << debug << "ql: new thread for query, adding.." << endl;
+    for (; notmuch_threads_valid (threads);
+           notmuch_threads_move_to_next (threads)) {
+      notmuch_thread_t * thread = notmuch_threads_get (threads);
+      ustring tid = notmuch_thread_get_thread_id (thread);
 
-        /* get current cursor path, if we are at first row and the new addition
-         * is before we should scroll up. */
-        Gtk::TreePath path;
-        Gtk::TreeViewColumn *c;
-        list_view->get_cursor (path, c);
+      in_query.insert (tid);
 
-        auto iter = list_store->prepend ();
-        Gtk::ListStore::Row newrow = *iter;
+      Gtk::TreeIter fnd = find_thread (tid);
+      if (fnd) {
+        /* updated */
+        Gtk::ListStore::Row row = *fnd;
+        refptr<NotmuchThread> t = list_store->find_thread (tid);
+        if (t) {
+          t->load (thread);
+        } else {
+          t = refptr<NotmuchThread> (new NotmuchThread (thread));
+          list_store->keep (t);
+        }
 
-        NotmuchThread * t;
+        astroid->thread_cache->put (cache_key, t);
+        row[list_store->columns.newest_date] = t->newest_date;
+        row[list_store->columns.oldest_date] = t->oldest_date;
+        row[list_store->columns.unread]      = t->unread;
 
-        db->on_thread (thread_id, [&t](notmuch_thread_t *nmt) {
+        updated++;
+      } else {
+        /* added */
+        added.push_back (refptr<NotmuchThread> (new NotmuchThread (thread)));
+      }
 
-            t = new NotmuchThread (nmt);
+      notmuch_thread_destroy (thread);
+    }
 
-          });
+    notmuch_threads_destroy (threads);
+    notmuch_query_destroy (nmquery);
 
-        newrow[list_store->columns.newest_date] = t->newest_date;
-        newrow[list_store->columns.oldest_date] = t->oldest_date;
-        newrow[list_store->columns.thread_id]   = t->thread_id;
-        newrow[list_store->columns.thread]      = Glib::RefPtr<NotmuchThread>(t);
+    /* changed threads that are not in the query anymore have left it */
+    for (auto &tid : changed) {
+      if (in_query.count (tid)) continue;
 
-        /* check if we should select it (if this is the only item) */
-        if (list_store->children().size() == 1) {
-          if (!in_destructor)
-            first_thread_ready.emit ();
-        } else {
+      Gtk::TreeIter fnd = find_thread (tid);
+      if (fnd) {
+        /* deleted */
+        erase_thread (fnd);
+        deleted++;
+      }
+    }
 
-          if (path == Gtk::TreePath ("0")) {
-            Gtk::TreePath addpath = list_store->get_path (iter);
-            if (addpath <= path) {
-              list_view->set_cursor (addpath);
-            }
-          }
-        }
+    /* new threads are added to the top, in sort order */
+    if (!added.empty ()) {
+      Gtk::TreePath path;
+      Gtk::TreeViewColumn *c;
+      list_view->get_cursor (path, c);
 
-        changed = true;
+      for (auto t = added.rbegin (); t != added.rend (); t++) {
+        add_thread (*t, true);
+      }
+
+      if (list_store->children().size() == added.size ()) {
+        if (!in_destructor)
+          first_thread_ready.emit ();
+      } else if (path == Gtk::TreePath ("0")) {
+        list_view->set_cursor (path);
       }
     }
 
-    if (changed && !waiting_stats) {
+    log << debug << "ql: update threads: updated: " << updated << ", deleted: " << deleted << ", added: " << added.size () << " in " << ((clock() - t0) * 1000.0 / CLOCKS_PER_SEC) << " ms." << endl;
+
+    if ((updated + deleted + added.size ()) > 0 && !waiting_stats) {
       waiting_stats = true;
       make_stats.emit ();
     }
   }
 }
-
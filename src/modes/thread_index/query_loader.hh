@@ -3,6 +3,7 @@
 # include <thread>
 # include <mutex>
 # include <queue>
+# include <unordered_map>
 # include <notmuch.h>
 
 # include "proto.hh"
@@ -24,6 +25,7 @@ namespace Astroid {
       void reload ();
 
       unsigned int loaded_threads;
+      unsigned int total_threads;
       unsigned int total_messages;
       unsigned int unread_messages;
 
@@ -46,10 +48,25 @@ namespace Astroid {
     private:
       ustring query;
 
+      /* key of the thread summaries of this query, see ThreadCache */
+      std::string cache_key;
+
       std::atomic<bool> run;
       bool in_destructor = false;
       void loader ();
 
+      /* number of worker threads, each with its own read-only db, used to
+       * load the threads. 1 loads them serially in the loader thread. */
+      int  loader_threads;
+      void load_serial (Db &);
+      void load_parallel (Db &);
+      void count_threads (Db &);
+
+      std::vector<refptr<NotmuchThread>> load_chunk (
+          Db &,
+          std::vector<ustring>::const_iterator begin,
+          std::vector<ustring>::const_iterator end);
+
       std::thread loader_thread;
       std::mutex  loader_m;
 
@@ -59,10 +76,28 @@ namespace Astroid {
       void to_list_adder ();
       Glib::Dispatcher queue_has_data;
 
+      /* rows added to the list store per main loop iteration */
+      static const unsigned int rows_per_batch = 500;
+      sigc::connection rows_idle;
+      bool add_rows ();
+      void drain_rows ();
+
+      /* index of rows by thread id, rows in a ListStore have persistent
+       * iterators, so they stay valid until the row is removed. all rows
+       * must be added and removed through these. */
+      std::unordered_map<std::string, Gtk::TreeIter> thread_rows;
+
+      Gtk::TreeIter add_thread (refptr<NotmuchThread>, bool prepend = false);
+      void          erase_thread (Gtk::TreeIter);
+      Gtk::TreeIter find_thread (ustring thread_id);
+
       /* signal handlers */
 
-      void on_thread_changed (Db *, ustring);
+      void on_threads_changed (Db *, std::vector<ustring>);
       void on_refreshed ();
+      void on_refreshed_lastmod (Db *, unsigned long, unsigned long);
+
+      void update_threads (Db *, ustring match, std::vector<ustring> changed);
   };
 }
 
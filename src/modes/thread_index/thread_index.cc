@@ -215,10 +215,19 @@ namespace Astroid {
   }
 
   ustring ThreadIndex::get_label () {
+    ustring progress;
+    if (queryloader.loading ()) {
+      if (queryloader.total_threads > 0) {
+        progress = ustring::compose (" (%1%%)", queryloader.loaded_threads * 100 / queryloader.total_threads);
+      } else {
+        progress = " (%)";
+      }
+    }
+
     if (name == "")
-      return ustring::compose ("%1 (%2/%3)%4", query_string, queryloader.unread_messages, queryloader.total_messages, queryloader.loading() ? " (%)" : "");
+      return ustring::compose ("%1 (%2/%3)%4", query_string, queryloader.unread_messages, queryloader.total_messages, progress);
     else
-      return ustring::compose ("%1 (%2/%3)%4", name, queryloader.unread_messages, queryloader.total_messages, queryloader.loading() ? " (%)" : "");
+      return ustring::compose ("%1 (%2/%3)%4", name, queryloader.unread_messages, queryloader.total_messages, progress);
   }
 
   void ThreadIndex::open_thread (refptr<NotmuchThread> thread, bool new_tab, bool new_window) {
@@ -244,6 +253,9 @@ namespace Astroid {
       tv = thread_view;
     }
 
+    /* the message loader takes over the message being prefetched */
+    list_view->cancel_prefetch ();
+
     tv->load_thread (thread);
     tv->show ();
 
@@ -99,26 +99,37 @@ namespace Astroid {
       height              = content_height + line_spacing;
     }
 
-    if (thread->unread) {
-      font_description.set_weight (Pango::WEIGHT_BOLD);
-    } else {
-      font_description.set_weight (Pango::WEIGHT_NORMAL);
-    }
+    RenderedRow & row = get_rendered (widget, flags);
 
     if (background_color_selected.length() > 0) {
         render_background (cr, widget, background_area, flags);
     }
-    render_date (cr, widget, cell_area); // returns height
 
-    if (thread->total_messages > 1)
-      render_message_count (cr, widget, cell_area);
+    /* set color */
+    Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
+    Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
+    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
+
+    show_layout (cr, row.date_layout, date_start, cell_area);
+
+    if (row.message_count_layout)
+      show_layout (cr, row.message_count_layout, message_count_start, cell_area);
+
+    show_layout (cr, row.authors_layout, authors_start, cell_area);
+
+    if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
+      Gdk::Color bg (background_color_selected);
+      cr->set_source_rgb (bg.get_red_p(), bg.get_green_p(), bg.get_blue_p());
+    }
+
+    show_layout (cr, row.tags_layout, tags_start, cell_area);
 
-    render_authors (cr, widget, cell_area);
+    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
 
-    tags_width = render_tags (cr, widget, cell_area, flags); // returns width
+    tags_width = row.tags_width;
     subject_start = tags_start + tags_width / Pango::SCALE + ((tags_width > 0) ? padding : 0);
 
-    render_subject (cr, widget, cell_area, flags);
+    show_layout (cr, row.subject_layout, subject_start, cell_area);
 
     /*
     if (!last)
@@ -264,21 +275,93 @@ namespace Astroid {
 
   } // }}}
 
-  void ThreadIndexListCellRenderer::render_subject ( // {{{
+  ThreadIndexListCellRenderer::RenderedRow & ThreadIndexListCellRenderer::get_rendered ( // {{{
+      Gtk::Widget &widget,
+      Gtk::CellRendererState flags) {
+
+    bool selected = (flags & Gtk::CELL_RENDERER_SELECTED) != 0;
+
+    /* the date depends on the current time */
+    ustring date = Date::pretty_print (thread->newest_date);
+
+    if (thread->unread) {
+      font_description.set_weight (Pango::WEIGHT_BOLD);
+    } else {
+      font_description.set_weight (Pango::WEIGHT_NORMAL);
+    }
+
+    auto fnd = rendered_rows.find (thread->thread_id);
+
+    if (fnd != rendered_rows.end ()) {
+      RenderedRow & row = fnd->second;
+
+      if (row.version == thread->version && row.selected == selected) {
+        if (row.date != date) {
+          row.date        = date;
+          row.date_layout = layout_date (widget, date);
+        }
+
+        return row;
+      }
+    }
+
+    if (rendered_rows.size () >= max_rendered_rows) {
+      /* the rows are cheap to render again, they are only kept to avoid
+       * re-rendering the visible rows on every redraw. */
+      rendered_rows.clear ();
+    }
+
+    RenderedRow & row = rendered_rows[thread->thread_id];
+
+    row.version  = thread->version;
+    row.selected = selected;
+
+    row.date        = date;
+    row.date_layout = layout_date (widget, date);
+
+    if (thread->total_messages > 1) {
+      row.message_count_layout = layout_message_count (widget);
+    } else {
+      row.message_count_layout.reset ();
+    }
+
+    row.authors_layout = layout_authors (widget);
+    row.tags_layout    = layout_tags (widget, flags);
+    row.subject_layout = layout_subject (widget, flags);
+
+    int h;
+    row.tags_layout->get_size (row.tags_width, h);
+
+    return row;
+  }
+
+  void ThreadIndexListCellRenderer::invalidate_rendered () {
+    rendered_rows.clear ();
+  }
+
+  void ThreadIndexListCellRenderer::show_layout (
       const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+      refptr<Pango::Layout> pango_layout,
+      int x,
+      const Gdk::Rectangle &cell_area ) {
+
+    /* align in the middle */
+    int w, h;
+    pango_layout->get_size (w, h);
+    int y = max(0,(line_height / 2) - ((h / Pango::SCALE) / 2));
+
+    cr->move_to (cell_area.get_x() + x, cell_area.get_y() + y);
+    pango_layout->show_in_cairo_context (cr);
+  } // }}}
+
+  refptr<Pango::Layout> ThreadIndexListCellRenderer::layout_subject ( // {{{
       Gtk::Widget &widget,
-      const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
     Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
 
     pango_layout->set_font_description (font_description);
 
-    /* set color */
-    Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
-
-    Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
-    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
     ustring color_str;
     if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
       color_str = subject_color_selected;
@@ -290,32 +373,18 @@ namespace Astroid {
         color_str,
         Glib::Markup::escape_text(thread->subject)));
 
-    /* align in the middle */
-    int w, h;
-    pango_layout->get_size (w, h);
-    int y = max(0,(line_height / 2) - ((h / Pango::SCALE) / 2));
-
-    cr->move_to (cell_area.get_x() + subject_start, cell_area.get_y() + y);
-    pango_layout->show_in_cairo_context (cr);
+    return pango_layout;
 
   } // }}}
 
-  int ThreadIndexListCellRenderer::render_tags ( // {{{
-      const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+  refptr<Pango::Layout> ThreadIndexListCellRenderer::layout_tags ( // {{{
       Gtk::Widget &widget,
-      const Gdk::Rectangle &cell_area,
       Gtk::CellRendererState flags) {
 
     Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout ("");
 
     pango_layout->set_font_description (font_description);
 
-    /* set color */
-    Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
-
-    Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
-    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
-
     /* subtract hidden tags */
     vector<ustring> tags;
     set_difference (thread->tags.begin(),
@@ -330,7 +399,6 @@ namespace Astroid {
 
     if ((flags & Gtk::CELL_RENDERER_SELECTED) != 0) {
       bg = Gdk::Color (background_color_selected);
-      cr->set_source_rgb (bg.get_red_p(), bg.get_green_p(), bg.get_blue_p());
     } else {
       bg.set_grey_p (1.);
     }
@@ -351,53 +419,24 @@ namespace Astroid {
 
     pango_layout->set_markup (tag_string);
 
-    /* align in the middle */
-    int w, h;
-    pango_layout->get_size (w, h);
-    int y = max(0,(line_height / 2) - ((h / Pango::SCALE) / 2));
-
-    cr->move_to (cell_area.get_x() + tags_start, cell_area.get_y() + y);
-    pango_layout->show_in_cairo_context (cr);
-
-    return w;
+    return pango_layout;
 
   } // }}}
 
-  int ThreadIndexListCellRenderer::render_date ( // {{{
-      const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+  refptr<Pango::Layout> ThreadIndexListCellRenderer::layout_date ( // {{{
       Gtk::Widget &widget,
-      const Gdk::Rectangle &cell_area ) {
-
-    ustring date = Date::pretty_print (thread->newest_date);
+      ustring date) {
 
     Glib::RefPtr<Pango::Layout> pango_layout = widget.create_pango_layout (date);
 
     pango_layout->set_font_description (font_description);
 
-    /* set color */
-    Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
-    Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
-    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
-
-    /* align in the middle */
-    int w, h;
-    pango_layout->get_size (w, h);
-    int y = max(0,(line_height / 2) - ((h / Pango::SCALE) / 2));
-
-    /* update subject start */
-    //subject_start = date_start + (w / Pango::SCALE) + padding;
-
-    cr->move_to (cell_area.get_x() + date_start, cell_area.get_y() + y);
-    pango_layout->show_in_cairo_context (cr);
-
-    return h; // return height!
+    return pango_layout;
 
   } // }}}
 
-  void ThreadIndexListCellRenderer::render_message_count ( // {{{
-      const ::Cairo::RefPtr< ::Cairo::Context>&cr,
-      Gtk::Widget &widget,
-      const Gdk::Rectangle &cell_area ) {
+  refptr<Pango::Layout> ThreadIndexListCellRenderer::layout_message_count ( // {{{
+      Gtk::Widget &widget) {
 
 # define BUFLEN 24
     char buf[BUFLEN];
@@ -408,28 +447,12 @@ namespace Astroid {
 
     pango_layout->set_font_description (font_description);
 
-    /* set color */
-    Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
-    Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
-    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
-
-    /* align in the middle */
-    int w, h;
-    pango_layout->get_size (w, h);
-    int y = max(0,(line_height / 2) - ((h / Pango::SCALE) / 2));
-
-    /* update subject start */
-    //subject_start = date_start + (w / Pango::SCALE) + padding;
-
-    cr->move_to (cell_area.get_x() + message_count_start, cell_area.get_y() + y);
-    pango_layout->show_in_cairo_context (cr);
+    return pango_layout;
 
   } // }}}
 
-  void ThreadIndexListCellRenderer::render_authors ( // {{{
-      const ::Cairo::RefPtr< ::Cairo::Context>&cr,
-      Gtk::Widget &widget,
-      const Gdk::Rectangle &cell_area ) {
+  refptr<Pango::Layout> ThreadIndexListCellRenderer::layout_authors ( // {{{
+      Gtk::Widget &widget) {
 
     /* format authors string */
     ustring authors;
@@ -506,21 +529,7 @@ namespace Astroid {
       font_description.set_weight (Pango::WEIGHT_BOLD);
     }
 
-    /* set color */
-    Glib::RefPtr<Gtk::StyleContext> stylecontext = widget.get_style_context();
-    Gdk::RGBA color = stylecontext->get_color(Gtk::STATE_FLAG_NORMAL);
-    cr->set_source_rgb (color.get_red(), color.get_green(), color.get_blue());
-
-    /* align in the middle */
-    int w, h;
-    pango_layout->get_size (w, h);
-    int y = max(0,(line_height / 2) - ((h / Pango::SCALE) / 2));
-
-    /* update subject start */
-    //subject_start = date_start + (w / Pango::SCALE) + padding;
-
-    cr->move_to (cell_area.get_x() + authors_start, cell_area.get_y() + y);
-    pango_layout->show_in_cairo_context (cr);
+    return pango_layout;
 
   } // }}}
 
@@ -1,6 +1,8 @@
 # pragma once
 
 # include <vector>
+# include <string>
+# include <unordered_map>
 
 # include <gtkmm.h>
 # include <gtkmm/cellrenderer.h>
@@ -26,6 +28,10 @@ namespace Astroid {
 
       int get_height ();
 
+      /* drop all rendered rows, must be called when the theme or fonts
+       * change */
+      void invalidate_rendered ();
+
     protected:
       /* best documentation so far from here:
        * https://git.gnome.org/browse/gtkmm/tree/gtk/src/cellrenderer.hg
@@ -104,38 +110,58 @@ namespace Astroid {
       ustring subject_color_selected; // configurable
       ustring background_color_selected; // configurable
 
+      /* the layouts of a row are kept until the thread changes (see
+       * NotmuchThread::version) or the row is (de-)selected. */
+      struct RenderedRow {
+        unsigned int version;
+        bool         selected;
+
+        ustring date;
+        refptr<Pango::Layout> date_layout;
+        refptr<Pango::Layout> message_count_layout;
+        refptr<Pango::Layout> authors_layout;
+        refptr<Pango::Layout> tags_layout;
+        refptr<Pango::Layout> subject_layout;
+
+        int tags_width;
+      };
+
+      std::unordered_map<std::string, RenderedRow> rendered_rows;
+      const unsigned int max_rendered_rows = 1000;
+
+      RenderedRow & get_rendered (
+          Gtk::Widget &widget,
+          Gtk::CellRendererState flags);
+
+      void show_layout (
+          const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+          refptr<Pango::Layout> layout,
+          int x,
+          const Gdk::Rectangle &cell_area );
+
       void render_background (
           const ::Cairo::RefPtr< ::Cairo::Context>&cr,
           Gtk::Widget &widget,
           const Gdk::Rectangle &background_area,
           Gtk::CellRendererState flags);
 
-      void render_subject (
-          const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+      refptr<Pango::Layout> layout_subject (
           Gtk::Widget &widget,
-          const Gdk::Rectangle &cell_area,
           Gtk::CellRendererState flags);
 
-      int render_tags (
-          const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+      refptr<Pango::Layout> layout_tags (
           Gtk::Widget &widget,
-          const Gdk::Rectangle &cell_area,
-          Gtk::CellRendererState flags );
+          Gtk::CellRendererState flags);
 
-      int render_date (
-          const ::Cairo::RefPtr< ::Cairo::Context>&cr,
+      refptr<Pango::Layout> layout_date (
           Gtk::Widget &widget,
-          const Gdk::Rectangle &cell_area );
+          ustring date);
 
-      void render_message_count (
-          const ::Cairo::RefPtr< ::Cairo::Context>&cr,
-          Gtk::Widget &widget,
-          const Gdk::Rectangle &cell_area );
+      refptr<Pango::Layout> layout_message_count (
+          Gtk::Widget &widget);
 
-      void render_authors (
-          const ::Cairo::RefPtr< ::Cairo::Context>&cr,
-          Gtk::Widget &widget,
-          const Gdk::Rectangle &cell_area );
+      refptr<Pango::Layout> layout_authors (
+          Gtk::Widget &widget);
 
       void render_delimiter (
           const ::Cairo::RefPtr< ::Cairo::Context>&cr,
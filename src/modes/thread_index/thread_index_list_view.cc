@@ -2,6 +2,7 @@
 # include <algorithm>
 # include <vector>
 # include <functional>
+# include <stdexcept>
 
 # include "db.hh"
 # include "log.hh"
@@ -16,6 +17,7 @@
 # include "modes/reply_message.hh"
 # include "modes/forward_message.hh"
 # include "message_thread.hh"
+# include "thread_cache.hh"
 # include "utils/utils.hh"
 # include "utils/cmd.hh"
 # include "utils/resource.hh"
@@ -70,16 +72,243 @@ namespace Astroid {
     add (newest_date);
     add (oldest_date);
     add (thread_id);
-    add (thread);
+    add (unread);
     add (marked);
   }
 
   ThreadIndexListStore::ThreadIndexListStore () {
     set_column_types (columns);
+
+    details_run = true;
+
+    cached_threads = astroid->config ("thread_index").get<unsigned int> ("cached_threads");
+    if (cached_threads < 100) cached_threads = 100;
+
+    details_ready.connect (
+        sigc::mem_fun (this, &ThreadIndexListStore::on_details_ready));
   }
 
   ThreadIndexListStore::~ThreadIndexListStore () {
     log << debug << "tils: deconstuct." << endl;
+
+    std::unique_lock<std::mutex> lk (details_m);
+    details_run = false;
+    lk.unlock ();
+    details_cv.notify_all ();
+
+    if (details_thread.joinable ()) details_thread.join ();
+  }
+
+  refptr<NotmuchThread> ThreadIndexListStore::get_thread (
+      const Gtk::TreeIter & iter,
+      bool load,
+      bool async)
+  {
+    Gtk::ListStore::Row row = *iter;
+    ustring thread_id = row[columns.thread_id];
+
+    refptr<NotmuchThread> thread = find_thread (thread_id);
+
+    if (!thread) {
+      thread = astroid->thread_cache->get (cache_key, thread_id);
+    }
+
+    if (!thread) {
+      /* only the fields of the row are known until the thread is loaded */
+      thread = refptr<NotmuchThread> (new NotmuchThread (thread_id));
+      thread->newest_date = row[columns.newest_date];
+      thread->oldest_date = row[columns.oldest_date];
+      thread->unread      = row[columns.unread];
+
+      unloaded.insert (thread_id);
+    }
+
+    touch (thread, load || unloaded.count (thread_id), async);
+
+    return thread;
+  }
+
+  refptr<NotmuchThread> ThreadIndexListStore::find_thread (ustring thread_id) {
+    auto fnd = lru_index.find (thread_id);
+
+    if (fnd != lru_index.end ()) {
+      return *(fnd->second);
+    } else {
+      return refptr<NotmuchThread> ();
+    }
+  }
+
+  void ThreadIndexListStore::keep (refptr<NotmuchThread> thread) {
+    if (lru.size () < cached_threads) touch (thread, false, false);
+  }
+
+  void ThreadIndexListStore::touch (refptr<NotmuchThread> thread, bool load, bool async) {
+    auto fnd = lru_index.find (thread->thread_id);
+    if (fnd != lru_index.end ()) {
+      lru.erase (fnd->second);
+    }
+
+    lru.push_front (thread);
+    lru_index[thread->thread_id] = lru.begin ();
+
+    if (load && !thread->details_loaded) {
+      refptr<NotmuchThread> cached = astroid->thread_cache->get (cache_key, thread->thread_id, true);
+
+      if (cached) {
+        set_loaded (thread, cached);
+      } else if (async) {
+        request_details (thread->thread_id);
+      } else {
+        Db db (Db::DATABASE_READ_ONLY);
+        refptr<NotmuchThread> t (new NotmuchThread (thread->thread_id));
+        t->refresh (&db);
+
+        set_loaded (thread, t);
+        astroid->thread_cache->put (cache_key, thread);
+      }
+    }
+
+    /* evict least recently touched, rows keep their thread id only */
+    while (lru.size () > cached_threads) {
+      refptr<NotmuchThread> t = lru.back ();
+      lru.pop_back ();
+
+      lru_index.erase (t->thread_id);
+      unloaded.erase (t->thread_id);
+
+      std::lock_guard<std::mutex> lk (details_m);
+      details_wanted.erase (t->thread_id);
+    }
+  }
+
+  void ThreadIndexListStore::set_loaded (
+      refptr<NotmuchThread> thread,
+      refptr<NotmuchThread> loaded)
+  {
+    thread->total_messages = loaded->total_messages;
+    thread->unread         = loaded->unread;
+    thread->attachment     = loaded->attachment;
+    thread->flagged        = loaded->flagged;
+    thread->tags           = loaded->tags;
+    thread->subject        = loaded->subject;
+    thread->authors        = loaded->authors;
+    thread->details_loaded = true;
+    thread->version        = NotmuchThread::next_version ();
+
+    unloaded.erase (thread->thread_id);
+  }
+
+  void ThreadIndexListStore::clear_cache () {
+    lru.clear ();
+    lru_index.clear ();
+    unloaded.clear ();
+
+    std::lock_guard<std::mutex> lk (details_m);
+    details_queue.clear ();
+    details_wanted.clear ();
+  }
+
+  sigc::signal<void> ThreadIndexListStore::signal_details_loaded () {
+    return m_signal_details_loaded;
+  }
+
+  void ThreadIndexListStore::request_details (ustring thread_id) {
+    std::lock_guard<std::mutex> lk (details_m);
+
+    if (!details_wanted.insert (thread_id).second) return; // already queued
+
+    details_queue.push_back (thread_id);
+
+    if (!details_thread.joinable ()) {
+      details_thread = std::thread (&ThreadIndexListStore::details_worker, this);
+    }
+
+    details_cv.notify_one ();
+  }
+
+  void ThreadIndexListStore::details_worker () {
+    /* important: we cannot safely output debug info from this thread */
+    std::unique_lock<std::mutex> lk (details_m);
+
+    while (true) {
+      details_cv.wait (lk, [&] { return !details_run || !details_queue.empty (); });
+      if (!details_run) break;
+
+      /* the most recently requested threads first: they are the ones on
+       * screen */
+      std::vector<ustring> ids;
+      while (!details_queue.empty () && ids.size () < details_batch) {
+        ustring id = details_queue.back ();
+        details_queue.pop_back ();
+
+        if (details_wanted.count (id)) ids.push_back (id);
+      }
+
+      lk.unlock ();
+
+      std::vector<refptr<NotmuchThread>> loaded;
+      std::vector<ustring> failed;
+
+      {
+        Db db (Db::DATABASE_READ_ONLY);
+
+        for (auto &id : ids) {
+          if (!details_run) break;
+
+          try {
+            db.on_thread (id, [&] (notmuch_thread_t * nm_thread) {
+                if (nm_thread != NULL) {
+                  loaded.push_back (refptr<NotmuchThread> (new NotmuchThread (nm_thread, true)));
+                } else {
+                  failed.push_back (id);
+                }
+              });
+          } catch (std::invalid_argument &ex) {
+            /* thread has disappeared from the database */
+            failed.push_back (id);
+          }
+        }
+      }
+
+      lk.lock ();
+
+      for (auto &id : failed) details_wanted.erase (id);
+
+      if (!loaded.empty ()) {
+        details_done.insert (details_done.end (), loaded.begin (), loaded.end ());
+        loaded.clear ();
+
+        if (details_run) details_ready.emit ();
+      }
+    }
+  }
+
+  void ThreadIndexListStore::on_details_ready () {
+    std::vector<refptr<NotmuchThread>> done;
+    std::unique_lock<std::mutex> lk (details_m);
+    done.swap (details_done);
+
+    bool changed = false;
+
+    for (auto &t : done) {
+      /* evicted or cleared in the meantime */
+      if (!details_wanted.erase (t->thread_id)) continue;
+
+      auto fnd = lru_index.find (t->thread_id);
+      if (fnd == lru_index.end ()) continue;
+
+      refptr<NotmuchThread> thread = *(fnd->second);
+      if (thread->details_loaded) continue;
+
+      set_loaded (thread, t);
+      astroid->thread_cache->put (cache_key, thread);
+
+      changed = true;
+    }
+
+    lk.unlock ();
+
+    if (changed) m_signal_details_loaded.emit ();
   }
 
 
@@ -98,6 +327,8 @@ namespace Astroid {
 
     config = astroid->config ("thread_index");
     page_jump_rows     = config.get<int>("page_jump_rows");
+    prefetch_delay     = config.get<int>("prefetch.delay");
+    prefetch_neighbours = config.get<int>("prefetch.neighbours");
 
     set_model (list_store);
     set_enable_search (false);
@@ -117,14 +348,25 @@ namespace Astroid {
     column->set_cell_data_func (*renderer,
         sigc::mem_fun(this, &ThreadIndexListView::set_thread_data) );
 
-    /* re-draw every minute (check every second) */
-    Glib::signal_timeout ().connect (
-        sigc::mem_fun (this, &ThreadIndexListView::redraw), 1000);
+    /* the rendered rows depend on the theme and fonts */
+    signal_style_updated ().connect (
+        [&] () {
+          renderer->invalidate_rendered ();
+        });
 
     /* mouse click */
     signal_row_activated ().connect (
         sigc::mem_fun (this, &ThreadIndexListView::on_my_row_activated));
 
+    signal_cursor_changed ().connect (
+        sigc::mem_fun (this, &ThreadIndexListView::on_my_cursor_changed));
+
+    /* redraw rows when their details have been loaded */
+    list_store->signal_details_loaded ().connect (
+        [&] () {
+          queue_draw ();
+        });
+
     /* set up popup menu {{{ */
 
     /* icon list */
@@ -222,19 +464,118 @@ namespace Astroid {
 
   ThreadIndexListView::~ThreadIndexListView () {
     log << debug << "tilv: deconstruct." << endl;
+    redraw_timer.disconnect ();
+    prefetch_timer.disconnect ();
+  }
+
+  void ThreadIndexListView::on_my_cursor_changed () {
+    if (!prefetcher.enabled) return;
+
+    /* wait for the cursor to settle */
+    prefetcher.cancel ();
+    prefetch_timer.disconnect ();
+
+    prefetch_timer = Glib::signal_timeout ().connect (
+        sigc::mem_fun (this, &ThreadIndexListView::on_prefetch_timeout),
+        prefetch_delay);
+  }
+
+  void ThreadIndexListView::cancel_prefetch () {
+    prefetch_timer.disconnect ();
+    prefetcher.cancel ();
+  }
+
+  bool ThreadIndexListView::on_prefetch_timeout () {
+    Gtk::TreePath path;
+    Gtk::TreeViewColumn *c;
+    get_cursor (path, c);
+
+    if (!path) return false;
+
+    int row = path[0];
+    int n   = list_store->children ().size ();
+
+    /* the selected thread, then alternately the following and preceding
+     * threads */
+    std::vector<ustring> thread_ids;
+
+    auto add = [&] (int r) {
+      if (r < 0 || r >= n) return;
+
+      Gtk::TreeIter it = list_store->get_iter (Gtk::TreePath (1, r));
+      if (it) {
+        ustring thread_id = (*it)[list_store->columns.thread_id];
+        thread_ids.push_back (thread_id);
+      }
+    };
+
+    add (row);
+    for (int i = 1; i <= prefetch_neighbours; i++) {
+      add (row + i);
+      add (row - i);
+    }
+
+    prefetcher.prefetch (thread_ids);
+
+    return false;
+  }
+
+  void ThreadIndexListView::schedule_redraw (time_t t) {
+    if (t == 0) return;
+    if (redraw_timer.connected () && next_redraw <= t) return;
+
+    redraw_timer.disconnect ();
+
+    next_redraw = t;
+    time_t now  = time (NULL);
+
+    /* one second extra to not wake up just before the date changes */
+    unsigned int delay = (t > now ? t - now : 0) + 1;
+
+    redraw_timer = Glib::signal_timeout ().connect_seconds (
+        sigc::mem_fun (this, &ThreadIndexListView::redraw), delay);
   }
 
   bool ThreadIndexListView::redraw () {
-    chrono::duration<double> elapsed = chrono::steady_clock::now() - last_redraw;
+    /* redraw the visible rows whose date changed, and schedule the next
+     * change. rows that are not visible are updated when they are drawn. */
+    redraw_timer.disconnect ();
+
+    Gtk::TreePath start, end;
+    if (!get_visible_range (start, end)) return false;
+
+    time_t now  = time (NULL);
+    time_t next = 0;
+
+    Gtk::TreeViewColumn * column = get_column (0);
+
+    for (Gtk::TreePath path = start; path <= end; path.next ()) {
+      Gtk::TreeIter iter = list_store->get_iter (path);
+      if (!iter) break;
+
+      Gtk::ListStore::Row row = *iter;
+      time_t newest_date = row[list_store->columns.newest_date];
 
-    if (elapsed.count () >= 60) {
+      time_t change = Date::next_change (newest_date);
 
-      queue_draw ();
-      last_redraw = chrono::steady_clock::now();
+      if (change != 0 && change <= now) {
+        Gdk::Rectangle rect;
+        get_background_area (path, *column, rect);
 
+        int x, y;
+        convert_bin_window_to_widget_coords (rect.get_x (), rect.get_y (), x, y);
+        queue_draw_area (x, y, rect.get_width (), rect.get_height ());
+
+        /* the date after the redraw */
+        change = Date::next_change (newest_date);
+      }
+
+      if (change != 0 && (next == 0 || change < next)) next = change;
     }
 
-    return true;
+    schedule_redraw (next);
+
+    return false; // single shot
   }
 
 
@@ -249,9 +590,13 @@ namespace Astroid {
     if (iter) {
 
       Gtk::ListStore::Row row = *iter;
-      r->thread = row[list_store->columns.thread];
       r->marked = row[list_store->columns.marked];
 
+      /* never wait for the database while drawing */
+      r->thread = list_store->get_thread (iter, true, true);
+
+      schedule_redraw (Date::next_change (r->thread->newest_date));
+
     }
   }
 
@@ -309,8 +654,7 @@ namespace Astroid {
           while (fwditer) {
             row = *fwditer;
 
-            Glib::RefPtr<NotmuchThread> thread = row[list_store->columns.thread];
-            if (thread->unread) {
+            if (row[list_store->columns.unread]) {
               path = list_store->get_path (fwditer);
               set_cursor (path);
               found = true;
@@ -327,8 +671,7 @@ namespace Astroid {
             while (fwditer && list_store->get_path(fwditer) < thispath) {
             row = *fwditer;
 
-            Glib::RefPtr<NotmuchThread> thread = row[list_store->columns.thread];
-            if (thread->unread) {
+            if (row[list_store->columns.unread]) {
               path = list_store->get_path (fwditer);
               set_cursor (path);
               found = true;
@@ -361,8 +704,7 @@ namespace Astroid {
           while (iter) {
             row = *iter;
 
-            Glib::RefPtr<NotmuchThread> thread = row[list_store->columns.thread];
-            if (thread->unread) {
+            if (row[list_store->columns.unread]) {
               path = list_store->get_path (iter);
               set_cursor (path);
               found = true;
@@ -380,8 +722,7 @@ namespace Astroid {
             while (iter && list_store->get_path(iter) > thispath) {
             row = *iter;
 
-            Glib::RefPtr<NotmuchThread> thread = row[list_store->columns.thread];
-            if (thread->unread) {
+            if (row[list_store->columns.unread]) {
               path = list_store->get_path (iter);
               set_cursor (path);
               found = true;
@@ -957,7 +1298,7 @@ namespace Astroid {
             if (row[list_store->columns.marked]) {
 
               // row[list_store->columns.marked] = false;
-              refptr<NotmuchThread> thread = row[list_store->columns.thread];
+              refptr<NotmuchThread> thread = list_store->get_thread (fwditer, false);
 
               threads.push_back (refptr<NotmuchTaggable>::cast_dynamic(thread));
             }
@@ -1166,7 +1507,7 @@ namespace Astroid {
     if (iter) {
       Gtk::ListStore::Row row = *iter;
 
-      refptr<NotmuchThread> thread = row[list_store->columns.thread];
+      refptr<NotmuchThread> thread = list_store->get_thread (iter);
       thread->refresh (&db);
 
       list_store->row_changed (path, iter);
@@ -1187,8 +1528,7 @@ namespace Astroid {
     iter = list_store->get_iter (path);
 
     if (iter) {
-      Gtk::ListStore::Row row = *iter;
-      return row[list_store->columns.thread];
+      return list_store->get_thread (iter);
 
     } else {
       return refptr<NotmuchThread>();
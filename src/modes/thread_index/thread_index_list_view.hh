@@ -1,6 +1,13 @@
 # pragma once
 
-# include <chrono>
+# include <list>
+# include <vector>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <unordered_map>
+# include <unordered_set>
 
 # include <gtkmm.h>
 # include <gtkmm/liststore.h>
@@ -10,6 +17,7 @@
 # include "config.hh"
 # include "modes/mode.hh"
 # include "modes/keybindings.hh"
+# include "thread_prefetcher.hh"
 
 # include "notmuch.h"
 
@@ -32,7 +40,7 @@ namespace Astroid {
           Gtk::TreeModelColumn<time_t> newest_date;
           Gtk::TreeModelColumn<time_t> oldest_date;
           Gtk::TreeModelColumn<Glib::ustring> thread_id;
-          Gtk::TreeModelColumn<Glib::RefPtr<NotmuchThread>> thread;
+          Gtk::TreeModelColumn<bool> unread;
           Gtk::TreeModelColumn<bool> marked;
 
           ThreadIndexListStoreColumnRecord ();
@@ -41,6 +49,64 @@ namespace Astroid {
       ThreadIndexListStore ();
       ~ThreadIndexListStore ();
       const ThreadIndexListStoreColumnRecord columns;
+
+      /* a row only holds the thread id and the fields needed to sort and
+       * navigate the list, the thread objects are only kept for the most
+       * recently used rows. get_thread returns the thread of a row and
+       * loads it if necessary, with `load` including the details (subject
+       * and authors). with `async` the missing fields are loaded in the
+       * background and signal_details_loaded is emitted when they have
+       * been set. */
+      refptr<NotmuchThread> get_thread (const Gtk::TreeIter &, bool load = true, bool async = false);
+
+      /* the thread if it is kept */
+      refptr<NotmuchThread> find_thread (ustring thread_id);
+
+      /* keep an already loaded thread if there is room, so that the first
+       * rows can be drawn without loading them again */
+      void keep (refptr<NotmuchThread>);
+
+      void clear_cache ();
+
+      /* key of the thread summaries of the query, set by QueryLoader */
+      std::string cache_key;
+
+      sigc::signal<void> signal_details_loaded ();
+
+    private:
+      unsigned int cached_threads;
+
+      std::list<refptr<NotmuchThread>> lru;
+      std::unordered_map<std::string, std::list<refptr<NotmuchThread>>::iterator> lru_index;
+
+      /* threads that only have the fields of their row */
+      std::unordered_set<std::string> unloaded;
+
+      void touch (refptr<NotmuchThread>, bool load, bool async);
+
+      /* set all fields but the dates, which depend on the query */
+      void set_loaded (refptr<NotmuchThread> thread, refptr<NotmuchThread> loaded);
+
+      /* background loading of details: drawing a row must never wait for
+       * the database. the worker is started on the first request, it opens
+       * a read-only db for each small batch of threads. */
+      std::thread             details_thread;
+      std::mutex              details_m;
+      std::condition_variable details_cv;
+      std::atomic<bool>       details_run;
+
+      std::vector<ustring>                details_queue;
+      std::unordered_set<std::string>     details_wanted; // queued or loading
+      std::vector<refptr<NotmuchThread>>  details_done;
+
+      Glib::Dispatcher    details_ready;
+      sigc::signal<void>  m_signal_details_loaded;
+
+      static const unsigned int details_batch = 50;
+
+      void request_details (ustring thread_id);
+      void details_worker ();
+      void on_details_ready ();
   };
 
 
@@ -105,9 +171,24 @@ namespace Astroid {
       // bypass scrolled window
       virtual bool on_key_press_event (GdkEventKey *) override;
 
+      /* stop prefetching, e.g. when a thread is opened */
+      void cancel_prefetch ();
+
     private:
-      std::chrono::time_point<std::chrono::steady_clock> last_redraw;
+      /* the rows are redrawn when the pretty printed date of a visible
+       * row changes, no timer runs when none will change. */
+      time_t           next_redraw = 0;
+      sigc::connection redraw_timer;
+      void schedule_redraw (time_t);
       bool redraw ();
+
+      /* the threads around the cursor are prefetched once it has settled */
+      ThreadPrefetcher  prefetcher;
+      int               prefetch_delay;
+      int               prefetch_neighbours;
+      sigc::connection  prefetch_timer;
+      void on_my_cursor_changed ();
+      bool on_prefetch_timeout ();
   };
 
 
@@ -0,0 +1,203 @@
+# include <functional>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "db.hh"
+# include "log.hh"
+# include "message_thread.hh"
+# include "message_source.hh"
+# include "message_cache.hh"
+# include "thread_prefetcher.hh"
+# include "utils/vector_utils.hh"
+
+using std::endl;
+
+namespace Astroid {
+  ThreadPrefetcher::ThreadPrefetcher () {
+    ptree config = astroid->config ("thread_index.prefetch");
+
+    enabled = config.get<bool> ("enable") && astroid->message_cache->enabled;
+    budget  = config.get<size_t> ("budget") * 1024 * 1024;
+
+    run = false;
+    generation = 0;
+
+    parsed_ready.connect (
+        sigc::mem_fun (this, &ThreadPrefetcher::on_parsed_ready));
+  }
+
+  ThreadPrefetcher::~ThreadPrefetcher () {
+    cancel ();
+
+    if (worker_thread.joinable ()) {
+      run = false;
+      pending_cv.notify_all ();
+      worker_thread.join ();
+    }
+
+    std::lock_guard<std::mutex> lk (parsed_m);
+    while (!parsed.empty ()) parsed.pop ();
+  }
+
+  void ThreadPrefetcher::prefetch (std::vector<ustring> thread_ids) {
+    if (!enabled) return;
+
+    std::unique_lock<std::mutex> lk (pending_m);
+    pending = thread_ids;
+    generation++;
+
+    if (!worker_thread.joinable ()) {
+      run = true;
+      worker_thread = std::thread (&ThreadPrefetcher::worker, this);
+    }
+
+    lk.unlock ();
+    pending_cv.notify_one ();
+  }
+
+  void ThreadPrefetcher::cancel () {
+    std::lock_guard<std::mutex> lk (pending_m);
+    pending.clear ();
+    generation++;
+  }
+
+  void ThreadPrefetcher::worker () {
+    while (true) {
+      std::unique_lock<std::mutex> lk (pending_m);
+      pending_cv.wait (lk, [&] { return !run || !pending.empty (); });
+
+      if (!run) break;
+
+      std::vector<ustring> thread_ids;
+      std::swap (thread_ids, pending);
+      unsigned int gen = generation;
+      lk.unlock ();
+
+      size_t used = 0;
+
+      for (auto &tid : thread_ids) {
+        if (gen != generation || used >= budget) break;
+
+        try {
+          prefetch_thread (tid, gen, used);
+        } catch (std::exception &ex) {
+          /* the thread may have been removed since */
+          log << debug << "tp: could not prefetch thread: " << tid << ": " << ex.what () << endl;
+        }
+      }
+
+      log << debug << "tp: prefetched " << (used / 1024) << " kB." << endl;
+    }
+  }
+
+  void ThreadPrefetcher::prefetch_thread (ustring thread_id, unsigned int gen, size_t & used) {
+    /* list the messages that are not cached, the database is closed
+     * before the files are parsed */
+    std::vector<Stub> stubs;
+
+    {
+      Db db (Db::DATABASE_READ_ONLY);
+
+      db.on_thread (thread_id, [&](notmuch_thread_t * nm_thread)
+        {
+          if (nm_thread == NULL) return;
+
+          std::function<void(notmuch_messages_t *, int)> add_messages =
+            [&] (notmuch_messages_t * messages, int lvl) {
+
+            for (; notmuch_messages_valid (messages);
+                   notmuch_messages_move_to_next (messages)) {
+
+              notmuch_message_t * message = notmuch_messages_get (messages);
+
+              Stub s;
+              s.mid   = notmuch_message_get_message_id (message);
+              s.level = lvl;
+
+              const char * fn = notmuch_message_get_filename (message);
+              if (fn != NULL) s.fname = fn;
+
+              notmuch_tags_t * tags;
+              for (tags = notmuch_message_get_tags (message);
+                   notmuch_tags_valid (tags);
+                   notmuch_tags_move_to_next (tags)) {
+
+                s.tags.push_back (ustring (notmuch_tags_get (tags)));
+              }
+              notmuch_tags_destroy (tags);
+
+              if (!s.fname.empty () &&
+                  !has (s.tags, ustring ("encrypted")) &&
+                  !astroid->message_cache->contains (s.mid, s.fname))
+              {
+                stubs.push_back (s);
+              }
+
+              add_messages (notmuch_message_get_replies (message), lvl + 1);
+            }
+          };
+
+          add_messages (notmuch_thread_get_toplevel_messages (nm_thread), 0);
+        });
+
+      db.close ();
+    }
+
+    for (auto &s : stubs) {
+      if (gen != generation || used >= budget) return;
+
+      prefetch_message (thread_id, s, used);
+    }
+  }
+
+  void ThreadPrefetcher::prefetch_message (ustring thread_id, Stub & s, size_t & used) {
+    /* the message loader may be parsing it */
+    if (!astroid->message_cache->begin_parse (s.mid)) return;
+
+    refptr<Message> m;
+
+    try {
+      m = refptr<Message> (new Message (s.mid, thread_id, s.fname, s.level, false));
+      m->tags = s.tags;
+    } catch (std::exception &ex) {
+      /* an exception must not escape the prefetch thread */
+      log << debug << "tp: could not load message: " << s.mid << ": " << ex.what () << endl;
+      m.reset ();
+    }
+
+    if (m && m->source) used += m->source->size ();
+
+    /* taken over by a message loader */
+    if (astroid->message_cache->end_parse (s.mid, m)) return;
+
+    if (!m) return;
+
+    std::unique_lock<std::mutex> lk (parsed_m);
+    parsed.push (m);
+
+    /* the message is handed over to the gui thread */
+    m.reset ();
+    lk.unlock ();
+
+    parsed_ready.emit ();
+  }
+
+  void ThreadPrefetcher::on_parsed_ready () {
+    std::unique_lock<std::mutex> lk (parsed_m);
+
+    while (!parsed.empty ()) {
+      refptr<Message> m = parsed.front ();
+      parsed.pop ();
+
+      lk.unlock ();
+
+      m->connect_updated ();
+      astroid->message_cache->put (m);
+
+      lk.lock ();
+    }
+  }
+}
+
@@ -0,0 +1,66 @@
+# pragma once
+
+# include <atomic>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <queue>
+# include <vector>
+
+# include <gtkmm.h>
+# include <notmuch.h>
+
+# include "proto.hh"
+
+namespace Astroid {
+  /* parses the messages of the threads around the cursor of the thread
+   * index on a background thread and stores them in the message cache, so
+   * that opening one of them does not need to parse the message files.
+   *
+   * at most budget bytes of message files are parsed for each prefetch, a
+   * new prefetch cancels the current one. encrypted messages are never
+   * prefetched since decrypting might prompt for a passphrase.
+   *
+   * the database is only opened to list the messages of each thread, the
+   * files are parsed without holding it. a message loader that needs the
+   * message being parsed takes it over (see MessageCache::take_parse). */
+  class ThreadPrefetcher : public sigc::trackable {
+    public:
+      ThreadPrefetcher ();
+      ~ThreadPrefetcher ();
+
+      bool enabled;
+
+      /* prefetch the threads in order, replacing any current prefetch */
+      void prefetch (std::vector<ustring> thread_ids);
+      void cancel ();
+
+    private:
+      size_t budget;
+
+      std::atomic<bool>           run;
+      std::atomic<unsigned int>   generation;
+      std::thread                 worker_thread;
+      std::mutex                  pending_m;
+      std::condition_variable     pending_cv;
+      std::vector<ustring>        pending;
+
+      struct Stub {
+        ustring mid;
+        ustring fname;
+        int     level;
+        std::vector<ustring> tags;
+      };
+
+      void worker ();
+      void prefetch_thread (ustring thread_id, unsigned int gen, size_t & used);
+      void prefetch_message (ustring thread_id, Stub &, size_t & used);
+
+      std::mutex parsed_m;
+      std::queue<refptr<Message>> parsed;
+
+      Glib::Dispatcher parsed_ready;
+      void on_parsed_ready ();
+  };
+}
+
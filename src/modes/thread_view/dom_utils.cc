@@ -8,6 +8,8 @@
 using std::endl;
 
 namespace Astroid {
+  unsigned long DomUtils::operations = 0;
+
   std::string DomUtils::assemble_data_uri (ustring mime_type, gchar * &data, gsize len) {
 
     std::string base64 = "data:" + mime_type + ";base64," + Glib::Base64::encode (std::string(data, len));
@@ -37,6 +39,8 @@ namespace Astroid {
       WebKitDOMNode * node,
       bool            deep) {
 
+    operations++;
+
     return WEBKIT_DOM_HTML_ELEMENT(webkit_dom_node_clone_node (node, deep));
   }
 
@@ -47,6 +51,8 @@ namespace Astroid {
     GError * gerr = NULL;
     WebKitDOMHTMLElement *e;
 
+    operations++;
+
     if (WEBKIT_DOM_IS_DOCUMENT(node)) {
       e = WEBKIT_DOM_HTML_ELEMENT(
         webkit_dom_document_query_selector (WEBKIT_DOM_DOCUMENT(node),
@@ -66,5 +72,127 @@ namespace Astroid {
     return e;
   }
 
+  void DomUtils::insert_html (
+      WebKitDOMHTMLElement * element,
+      ustring                where,
+      ustring                html) {
+
+    GError * gerr = NULL;
+
+    operations++;
+
+    webkit_dom_html_element_insert_adjacent_html (element,
+        where.c_str (), html.c_str (), &gerr);
+
+    if (gerr != NULL)
+      log << error << "tv: insert_html: " << gerr->message << endl;
+  }
+
+  WebKitDOMElement * DomUtils::get_element_by_id (
+      WebKitDOMDocument * document,
+      const gchar *       id) {
+
+    operations++;
+    return webkit_dom_document_get_element_by_id (document, id);
+  }
+
+  WebKitDOMElement * DomUtils::create_element (
+      WebKitDOMDocument * document,
+      const gchar *       tag,
+      GError **           err) {
+
+    operations++;
+    return webkit_dom_document_create_element (document, tag, err);
+  }
+
+  void DomUtils::set_attribute (
+      WebKitDOMElement *  element,
+      const gchar *       name,
+      const gchar *       value,
+      GError **           err) {
+
+    operations++;
+    webkit_dom_element_set_attribute (element, name, value, err);
+  }
+
+  void DomUtils::remove_attribute (
+      WebKitDOMElement *  element,
+      const gchar *       name) {
+
+    operations++;
+    webkit_dom_element_remove_attribute (element, name);
+  }
+
+  void DomUtils::set_inner_html (
+      WebKitDOMHTMLElement * element,
+      const gchar *          html,
+      GError **              err) {
+
+    operations++;
+    webkit_dom_html_element_set_inner_html (element, html, err);
+  }
+
+  void DomUtils::set_inner_text (
+      WebKitDOMHTMLElement * element,
+      const gchar *          text,
+      GError **              err) {
+
+    operations++;
+    webkit_dom_html_element_set_inner_text (element, text, err);
+  }
+
+  WebKitDOMDOMTokenList * DomUtils::get_class_list (
+      WebKitDOMElement *  element) {
+
+    operations++;
+    return webkit_dom_element_get_class_list (element);
+  }
+
+  void DomUtils::class_list_add (
+      WebKitDOMDOMTokenList * class_list,
+      const gchar *           token,
+      GError **               err) {
+
+    operations++;
+    webkit_dom_dom_token_list_add (class_list, token, err);
+  }
+
+  void DomUtils::class_list_remove (
+      WebKitDOMDOMTokenList * class_list,
+      const gchar *           token,
+      GError **               err) {
+
+    operations++;
+    webkit_dom_dom_token_list_remove (class_list, token, err);
+  }
+
+  WebKitDOMNode * DomUtils::append_child (
+      WebKitDOMNode * parent,
+      WebKitDOMNode * child,
+      GError **       err) {
+
+    operations++;
+    return webkit_dom_node_append_child (parent, child, err);
+  }
+
+  WebKitDOMNode * DomUtils::insert_before (
+      WebKitDOMNode * parent,
+      WebKitDOMNode * child,
+      WebKitDOMNode * ref,
+      GError **       err) {
+
+    operations++;
+    return webkit_dom_node_insert_before (parent, child, ref, err);
+  }
+
+  WebKitDOMNode * DomUtils::remove_child (
+      WebKitDOMNode * parent,
+      WebKitDOMNode * child,
+      GError **       err) {
+
+    operations++;
+    return webkit_dom_node_remove_child (parent, child, err);
+  }
+
 }
 
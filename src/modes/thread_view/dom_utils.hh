@@ -26,6 +26,77 @@ namespace Astroid {
       static WebKitDOMHTMLElement * select (
           WebKitDOMNode * node,
           ustring         selector);
+
+      /* parse and insert html relative to element, where is one of
+       * beforebegin, afterbegin, beforeend or afterend */
+      static void insert_html (
+          WebKitDOMHTMLElement * element,
+          ustring                where,
+          ustring                html);
+
+      /* the webkit dom calls used to render messages, counted in
+       * operations. they take the same arguments as the webkit functions. */
+      static WebKitDOMElement * get_element_by_id (
+          WebKitDOMDocument * document,
+          const gchar *       id);
+
+      static WebKitDOMElement * create_element (
+          WebKitDOMDocument * document,
+          const gchar *       tag,
+          GError **           err);
+
+      static void set_attribute (
+          WebKitDOMElement *  element,
+          const gchar *       name,
+          const gchar *       value,
+          GError **           err);
+
+      static void remove_attribute (
+          WebKitDOMElement *  element,
+          const gchar *       name);
+
+      static void set_inner_html (
+          WebKitDOMHTMLElement * element,
+          const gchar *          html,
+          GError **              err);
+
+      static void set_inner_text (
+          WebKitDOMHTMLElement * element,
+          const gchar *          text,
+          GError **              err);
+
+      static WebKitDOMDOMTokenList * get_class_list (
+          WebKitDOMElement *  element);
+
+      static void class_list_add (
+          WebKitDOMDOMTokenList * class_list,
+          const gchar *           token,
+          GError **               err);
+
+      static void class_list_remove (
+          WebKitDOMDOMTokenList * class_list,
+          const gchar *           token,
+          GError **               err);
+
+      static WebKitDOMNode * append_child (
+          WebKitDOMNode * parent,
+          WebKitDOMNode * child,
+          GError **       err);
+
+      static WebKitDOMNode * insert_before (
+          WebKitDOMNode * parent,
+          WebKitDOMNode * child,
+          WebKitDOMNode * ref,
+          GError **       err);
+
+      static WebKitDOMNode * remove_child (
+          WebKitDOMNode * parent,
+          WebKitDOMNode * child,
+          GError **       err);
+
+      /* number of dom calls made through DomUtils, used to benchmark
+       * rendering (gui thread only) */
+      static unsigned long operations;
   };
 }
 
@@ -0,0 +1,241 @@
+# include <vector>
+# include <algorithm>
+# include <functional>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "db.hh"
+# include "log.hh"
+# include "message_thread.hh"
+# include "message_loader.hh"
+# include "message_cache.hh"
+# include "utils/vector_utils.hh"
+
+using std::endl;
+using std::vector;
+
+namespace Astroid {
+  MessageLoader::MessageLoader () {
+    loaded_ready.connect (
+        sigc::mem_fun (this, &MessageLoader::on_loaded_ready));
+  }
+
+  MessageLoader::~MessageLoader () {
+    stop ();
+  }
+
+  vector<MessageLoader::Stub> MessageLoader::start (Db * db, ustring _thread_id) {
+    stop ();
+
+    thread_id = _thread_id;
+
+    vector<Stub> stubs;
+
+    /* walk the thread in the same order as MessageThread::load_messages,
+     * only reading fields stored in the database. */
+    db->on_thread (thread_id, [&](notmuch_thread_t * nm_thread)
+      {
+        std::function<void(notmuch_messages_t *, int)> add_messages =
+          [&] (notmuch_messages_t * messages, int lvl) {
+
+          for (; notmuch_messages_valid (messages);
+                 notmuch_messages_move_to_next (messages)) {
+
+            notmuch_message_t * message = notmuch_messages_get (messages);
+
+            Stub s;
+            s.mid   = notmuch_message_get_message_id (message);
+            s.level = lvl;
+            s.date  = notmuch_message_get_date (message);
+
+            const char * c = notmuch_message_get_filename (message);
+            if (c != NULL) s.fname = c;
+
+            c = notmuch_message_get_header (message, "From");
+            if (c != NULL) s.sender = c;
+
+            c = notmuch_message_get_header (message, "Subject");
+            if (c != NULL) s.subject = c;
+
+            notmuch_tags_t * tags;
+            for (tags = notmuch_message_get_tags (message);
+                 notmuch_tags_valid (tags);
+                 notmuch_tags_move_to_next (tags)) {
+
+              s.tags.push_back (ustring (notmuch_tags_get (tags)));
+            }
+            notmuch_tags_destroy (tags);
+
+            s.unread = has (s.tags, ustring ("unread"));
+
+            stubs.push_back (s);
+
+            add_messages (notmuch_message_get_replies (message), lvl + 1);
+          }
+        };
+
+        add_messages (notmuch_thread_get_toplevel_messages (nm_thread), 0);
+      });
+
+    vector<Stub> order = stubs;
+    std::stable_sort (order.begin (), order.end (),
+        [] (const Stub & a, const Stub & b) {
+          if (a.unread != b.unread) return a.unread;
+          return a.date > b.date;
+        });
+
+    /* cached messages are handed over from the gui thread, only the rest
+     * are parsed in the background */
+    vector<Stub> parse;
+
+    std::unique_lock<std::mutex> lk (loaded_m);
+    unsigned long gen = generation;
+
+    for (auto &s : order) {
+      refptr<Message> m;
+      if (!s.fname.empty ()) m = astroid->message_cache->get (s.mid, s.fname);
+
+      if (m) {
+        Loaded l;
+        l.generation = gen;
+        l.mid        = s.mid;
+        l.level      = s.level;
+        l.message    = m;
+        l.cached     = true;
+        l.tags       = s.tags;
+
+        loaded.push (l);
+      } else {
+        parse.push_back (s);
+      }
+    }
+
+    bool cached = !loaded.empty ();
+    running = !parse.empty ();
+
+    lk.unlock ();
+
+    if (cached) loaded_ready.emit ();
+
+    if (!parse.empty ()) {
+      loader_thread = std::thread (&MessageLoader::loader, this, gen, parse);
+    }
+
+    return stubs;
+  }
+
+  void MessageLoader::stop () {
+    std::unique_lock<std::mutex> lk (loaded_m);
+
+    generation++;
+    running = false;
+
+    /* drop messages not yet handed over */
+    while (!loaded.empty ()) loaded.pop ();
+
+    lk.unlock ();
+
+    /* the loader thread stops after the message it is parsing */
+    if (loader_thread.joinable ()) loader_thread.join ();
+
+    /* drop anything it queued meanwhile */
+    lk.lock ();
+    while (!loaded.empty ()) loaded.pop ();
+  }
+
+  bool MessageLoader::loading () {
+    std::lock_guard<std::mutex> lk (loaded_m);
+    return running;
+  }
+
+  bool MessageLoader::current (unsigned long gen) {
+    std::lock_guard<std::mutex> lk (loaded_m);
+    return (generation == gen);
+  }
+
+  void MessageLoader::loader (unsigned long gen, vector<Stub> order)
+  {
+    for (auto &s : order) {
+      if (!current (gen)) return;
+
+      Loaded l;
+      l.generation = gen;
+      l.mid        = s.mid;
+      l.level      = s.level;
+      l.cached     = false;
+
+      /* a message that is being prefetched is taken over when it has been
+       * parsed, rather than parsing it again. */
+      bool parsing = astroid->message_cache->begin_parse (s.mid);
+
+      if (!parsing && astroid->message_cache->take_parse (s.mid, l.message)) {
+        l.message->level = s.level;
+        l.message->tags  = s.tags;
+
+      } else {
+        /* messages parsed here are not shared and not connected to any
+         * signal yet, they may be dropped on this thread. */
+        try {
+          l.message = refptr<Message> (new Message (s.mid, thread_id, s.fname, s.level, false));
+          l.message->tags = s.tags;
+        } catch (std::exception &ex) {
+          /* an exception must not escape the loader thread */
+          l.error = ex.what ();
+          l.message.reset ();
+        }
+
+        if (parsing) astroid->message_cache->end_parse (s.mid, l.message);
+      }
+
+      std::unique_lock<std::mutex> lk (loaded_m);
+      if (generation != gen) return;
+
+      loaded.push (l);
+      l.message.reset ();
+      lk.unlock ();
+
+      loaded_ready.emit ();
+    }
+
+    std::lock_guard<std::mutex> lk (loaded_m);
+    if (generation == gen) running = false;
+  }
+
+  void MessageLoader::on_loaded_ready () {
+    std::unique_lock<std::mutex> lk (loaded_m);
+
+    while (!loaded.empty ()) {
+      Loaded l = loaded.front ();
+      loaded.pop ();
+
+      /* left over from a stopped load */
+      if (l.generation != generation) continue;
+
+      lk.unlock ();
+
+      if (!l.error.empty ()) {
+        log << error << "ml: could not load message: " << l.mid << ": " << l.error << endl;
+      }
+
+      if (l.message) {
+        if (l.cached) {
+          l.message->level = l.level;
+          l.message->tags  = l.tags;
+        } else {
+          l.message->connect_updated ();
+          astroid->message_cache->put (l.message);
+        }
+      }
+
+      m_signal_message_loaded.emit (l.mid, l.message);
+
+      lk.lock ();
+    }
+  }
+
+  MessageLoader::type_signal_message_loaded MessageLoader::signal_message_loaded () {
+    return m_signal_message_loaded;
+  }
+}
+
@@ -0,0 +1,88 @@
+# pragma once
+
+# include <atomic>
+# include <thread>
+# include <mutex>
+# include <queue>
+# include <vector>
+
+# include <gtkmm.h>
+
+# include "proto.hh"
+# include "message_thread.hh"
+
+namespace Astroid {
+  /* loads the messages of a thread on a background thread: the message
+   * files are parsed (including decryption) off the gui thread, the most
+   * relevant messages first: unread, then newest. the loaded messages are
+   * handed over on the gui thread and stored in the message cache, cached
+   * messages are not parsed again.
+   *
+   * everything needed from the database is read when loading is started,
+   * the background thread parses the files without holding a database. a
+   * message that is being prefetched is taken over from the prefetcher. */
+  class MessageLoader : public sigc::trackable {
+    public:
+      MessageLoader ();
+      ~MessageLoader ();
+
+      /* the fields of a message available from the database, used until
+       * the message has been loaded */
+      struct Stub {
+        ustring mid;
+        ustring fname;
+        int     level;
+        ustring sender;
+        ustring subject;
+        time_t  date;
+        bool    unread;
+        std::vector<ustring> tags;
+      };
+
+      /* read the messages of the thread and start loading them, returns
+       * the messages in thread order. */
+      std::vector<Stub> start (Db *, ustring thread_id);
+      void stop ();
+
+      bool loading ();
+
+      /* emitted on the gui thread for every message, the message is empty
+       * if it could not be loaded. */
+      typedef sigc::signal <void, ustring, refptr<Message>> type_signal_message_loaded;
+      type_signal_message_loaded signal_message_loaded ();
+
+    private:
+      ustring thread_id;
+
+      /* a loaded message, or a cached message with the tags read from
+       * the database. errors are logged when the message is handed over,
+       * not on the loader thread. */
+      struct Loaded {
+        unsigned long         generation;
+        ustring               mid;
+        int                   level;
+        refptr<Message>       message;
+        bool                  cached;
+        std::vector<ustring>  tags;
+        ustring               error;
+      };
+
+      /* state shared with the loader thread. stop () bumps the generation,
+       * the loader thread checks it between messages and is joined, so it
+       * never outlives the loader. */
+      std::mutex          loaded_m;
+      bool                running    = false;
+      unsigned long       generation = 0;
+      std::queue<Loaded>  loaded;
+
+      std::thread         loader_thread;
+      void loader (unsigned long generation, std::vector<Stub> order);
+      bool current (unsigned long generation);
+
+      Glib::Dispatcher loaded_ready;
+      void on_loaded_ready ();
+
+      type_signal_message_loaded m_signal_message_loaded;
+  };
+}
+
@@ -33,6 +33,7 @@ namespace Astroid {
   const char * Theme::thread_view_css_f  = "ui/thread-view.css";
 # endif
   ustring Theme::thread_view_html;
+  bool    Theme::user_thread_view_html = false;
   ustring Theme::thread_view_css;
 
   Theme::Theme () {
@@ -42,7 +43,9 @@ namespace Astroid {
 
     /* load html and css (from scss) */
     if (!theme_loaded) {
-      path tv_html = Resource (true, thread_view_html_f).get_path ();
+      Resource tv_html_r (true, thread_view_html_f);
+      path tv_html = tv_html_r.get_path ();
+      user_thread_view_html = tv_html_r.user_configured;
 
       if (!check_theme_version (tv_html)) {
 
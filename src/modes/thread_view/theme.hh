@@ -21,6 +21,9 @@ namespace Astroid {
 # endif
       static ustring       thread_view_html;
       static ustring       thread_view_css;
+
+      /* the thread view html is a custom theme in the config dir */
+      static bool          user_thread_view_html;
       const char * STYLE_NAME = "STYLE";
       const int THEME_VERSION = 3;
 
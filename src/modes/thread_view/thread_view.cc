@@ -12,12 +12,15 @@
 # include "web_inspector.hh"
 # include "dom_utils.hh"
 # include "theme.hh"
+# include "web_view_pool.hh"
 
 # include "main_window.hh"
 # include "message_thread.hh"
+# include "message_source.hh"
 # include "chunk.hh"
 # include "crypto.hh"
 # include "db.hh"
+# include "thumbnail_cache.hh"
 # include "utils/utils.hh"
 # include "utils/address.hh"
 # include "utils/vector_utils.hh"
@@ -39,9 +42,17 @@ using namespace std;
 
 namespace Astroid {
 
-  ThreadView::ThreadView (MainWindow * mw) : Mode (mw) { // {{{
+  ThreadView::ThreadView (MainWindow * mw) : Mode (mw), thumbnail_loader (THUMBNAIL_WIDTH) { // {{{
     const ptree& config = astroid->config ("thread_view");
     indent_messages = config.get<bool> ("indent_messages");
+    batch_render = config.get<bool> ("batch_render");
+
+    /* the batch html has the structure of the templates of the stock
+     * theme, a custom theme is filled in element by element */
+    if (batch_render && Theme::user_thread_view_html) {
+      log << info << "tv: custom thread view html, batch rendering disabled." << endl;
+      batch_render = false;
+    }
     open_html_part_external = config.get<bool> ("open_html_part_external");
     open_external_link = config.get<string> ("open_external_link");
 
@@ -69,64 +80,12 @@ namespace Astroid {
 
     pack_start (scroll, true, true, 5);
 
-    /* set up webkit web view (using C api) */
-    webview = WEBKIT_WEB_VIEW (webkit_web_view_new ());
-
-    /* dpi */
-    /*
-    WebKitViewportAttributes* attributes = webkit_web_view_get_viewport_attributes (webview);
-
-    gint dpi;
-    gfloat dpr;
-    g_object_get (G_OBJECT (attributes), "device-dpi", &dpi, NULL);
-    g_object_get (G_OBJECT (attributes), "device-pixel-ratio", &dpr, NULL);
-
-    log << debug << "web: dpi: " << dpi << ", dpr: " << dpr << endl;
-    auto win = get_screen ();
-    double gdpi = win->get_resolution ();
-
-    log << debug << "gdk: dpi: " << gdpi << endl;
-
-    g_object_set (G_OBJECT (attributes), "device-dpi", (int)gdpi, NULL);
-
-    webkit_viewport_attributes_recompute (attributes);
-
-    g_object_get (G_OBJECT (attributes), "device-dpi", &dpi, NULL);
-    g_object_get (G_OBJECT (attributes), "device-pixel-ratio", &dpr, NULL);
-
-    log << debug << "web: dpi: " << dpi << ", dpr: " << dpr << endl;
-
-    bool valid;
-    g_object_get (G_OBJECT (attributes), "valid", &valid, NULL);
-    log << debug << "web: valid: " << valid << endl;
-    */
-
-    websettings = WEBKIT_WEB_SETTINGS (webkit_web_settings_new ());
-    g_object_set (G_OBJECT(websettings),
-        "enable-scripts", TRUE,
-        "enable-java-applet", FALSE,
-        "enable-plugins", FALSE,
-        "auto-load-images", TRUE,
-        "enable-display-of-insecure-content", FALSE,
-        "enable-dns-prefetching", FALSE,
-        "enable-fullscreen", FALSE,
-        "enable-html5-database", FALSE,
-        "enable-html5-local-storage", FALSE,
-     /* "enable-mediastream", FALSE, */
-        "enable-mediasource", FALSE,
-        "enable-offline-web-application-cache", FALSE,
-        "enable-page-cache", FALSE,
-        "enable-private-browsing", TRUE,
-        "enable-running-of-insecure-content", FALSE,
-        "enable-display-of-insecure-content", FALSE,
-        "enable-xss-auditor", TRUE,
-        "media-playback-requires-user-gesture", TRUE,
-        "enable-developer-extras", TRUE, // TODO: should only enabled conditionally
-
-        NULL);
-
-    webkit_web_view_set_settings (webview, websettings);
-
+    /* set up webkit web view (using C api), the web view comes from the
+     * pool with the document already loaded if one is ready */
+    view        = astroid->web_view_pool->get ();
+    webview     = view->webview;
+    websettings = webkit_web_view_get_settings (webview);
+    home_uri    = view->home_uri;
 
     gtk_container_add (GTK_CONTAINER (scroll.gobj()), GTK_WIDGET(webview));
 
@@ -134,6 +93,7 @@ namespace Astroid {
 
     wk_loaded = false;
 
+    /* the pool styles the document before this is notified */
     g_signal_connect (webview, "notify::load-status",
         G_CALLBACK(ThreadView_on_load_changed),
         (gpointer) this );
@@ -177,6 +137,20 @@ namespace Astroid {
         ATTACHMENT_ICON_WIDTH,
         Gtk::ICON_LOOKUP_USE_BUILTIN );
 
+    /* the icons are inserted as data uris in every message */
+    {
+      gchar * content;
+      gsize   content_size;
+
+      attachment_icon->save_to_buffer (content, content_size, "png");
+      attachment_icon_uri = DomUtils::assemble_data_uri ("image/png", content, content_size);
+      g_free (content);
+
+      marked_icon->save_to_buffer (content, content_size, "png");
+      marked_icon_uri = DomUtils::assemble_data_uri ("image/png", content, content_size);
+      g_free (content);
+    }
+
     register_keys ();
 
     show_all_children ();
@@ -188,19 +162,36 @@ namespace Astroid {
 
     astroid->actions->signal_thread_updated ().connect (
         sigc::mem_fun (this, &ThreadView::on_thread_updated));
+
+    astroid->actions->signal_refreshed_lastmod ().connect (
+        sigc::mem_fun (this, &ThreadView::on_refreshed_lastmod));
+
+    message_loader.signal_message_loaded ().connect (
+        sigc::mem_fun (this, &ThreadView::on_message_loaded));
+
+    thumbnail_loader.signal_thumbnail_ready ().connect (
+        sigc::mem_fun (this, &ThreadView::on_thumbnail_ready));
   }
 
   // }}}
 
   ThreadView::~ThreadView () { // {{{
     log << debug << "tv: deconstruct." << endl;
-    // TODO: possibly still some errors here in paned mode
-    //g_object_unref (webview); // probably garbage collected since it has a parent widget
-    //g_object_unref (websettings);
+    message_loader.stop ();
+    disconnect_message_changed ();
     if (container) g_object_unref (container);
+
+    /* the web view is destroyed with the scrolled window */
+    g_signal_handlers_disconnect_by_data (webview, this);
+    g_signal_handlers_disconnect_by_data (
+        webkit_web_view_get_inspector (webview), &thread_view_inspector);
+
+    astroid->web_view_pool->release (view);
   }
 
   void ThreadView::pre_close () {
+    message_loader.stop ();
+
 # ifndef DISABLE_PLUGINS
     plugins->deactivate ();
     delete plugins;
@@ -241,6 +232,25 @@ namespace Astroid {
     const gchar * uri_c = webkit_network_request_get_uri (request);
     ustring uri (uri_c);
 
+    /* serve cached thumbnails from the thumbnail cache, the uri may have
+     * been resolved against the base uri of the page */
+    ustring thumbnail_prefix = home_uri + "/thumbnails/";
+    size_t tp = uri.find (thumbnail_prefix);
+    if (tp != ustring::npos) {
+      ustring key = uri.substr (tp + thumbnail_prefix.length ());
+      key = key.substr (0, key.rfind (".png"));
+
+      bfs::path p;
+      if (astroid->thumbnail_cache->get (key, p)) {
+        webkit_network_request_set_uri (request, Glib::filename_to_uri (p.c_str ()).c_str ());
+      } else {
+        log << warn << "tv: thumbnail not in cache: " << key << endl;
+        webkit_network_request_set_uri (request, "about:blank");
+      }
+
+      return;
+    }
+
     // prefix of local uris for loading image thumbnails
     vector<ustring> allowed_uris =
       {
@@ -303,7 +313,7 @@ namespace Astroid {
     for (auto &m : mthread->messages) {
 
       ustring div_id = "message_" + m->mid;
-      WebKitDOMElement * me = webkit_dom_document_get_element_by_id (d, div_id.c_str());
+      WebKitDOMElement * me = DomUtils::get_element_by_id (d, div_id.c_str());
 
       WebKitDOMNodeList * imgs = webkit_dom_element_query_selector_all (me, "img", (err = NULL, &err));
 
@@ -316,8 +326,8 @@ namespace Astroid {
         if (ine != NULL) {
           gchar * src = webkit_dom_element_get_attribute (ine, "src");
           if (src != NULL) {
-            webkit_dom_element_set_attribute (ine, "src", "", (err = NULL, &err));
-            webkit_dom_element_set_attribute (ine, "src", src, (err = NULL, &err));
+            DomUtils::set_attribute (ine, "src", "", (err = NULL, &err));
+            DomUtils::set_attribute (ine, "src", src, (err = NULL, &err));
           }
 
           // TODO: cid type images or attachment references are not loaded
@@ -479,121 +489,120 @@ namespace Astroid {
   {
     WebKitLoadStatus ev = webkit_web_view_get_load_status (webview);
     log << debug << "tv: on_load_changed: " << ev << endl;
-    switch (ev) {
-      case WEBKIT_LOAD_FINISHED:
-        log << debug << "tv: load finished." << endl;
-        {
-
-          /* load css style */
-          GError *err = NULL;
-          WebKitDOMDocument *d = webkit_web_view_get_dom_document (webview);
-          WebKitDOMElement  *e = webkit_dom_document_create_element (d, theme.STYLE_NAME, &err);
 
-          WebKitDOMText *t = webkit_dom_document_create_text_node
-            (d, theme.thread_view_css.c_str());
+    /* render if a thread is waiting for the document */
+    if (ev == WEBKIT_LOAD_FINISHED && view->loaded && mthread && !wk_loaded) {
+      log << debug << "tv: load finished." << endl;
+      document_ready ();
+    }
 
-          webkit_dom_node_append_child (WEBKIT_DOM_NODE(e), WEBKIT_DOM_NODE(t), (err = NULL, &err));
+    return true;
+  }
 
-          WebKitDOMHTMLHeadElement * head = webkit_dom_document_get_head (d);
-          webkit_dom_node_append_child (WEBKIT_DOM_NODE(head), WEBKIT_DOM_NODE(e), (err = NULL, &err));
+  void ThreadView::document_ready () {
+    /* the document is loaded and styled, add the scripts needed by this
+     * thread and clear the messages of the previous thread */
+    GError *err = NULL;
+    WebKitDOMDocument *d = webkit_web_view_get_dom_document (webview);
+    WebKitDOMHTMLHeadElement * head = webkit_dom_document_get_head (d);
 
-          /* load mathjax if enabled */
-          if (enable_mathjax) {
-            bool only_tags_ok = false;
-            if (mathjax_only_tags.size () > 0) {
-              if (mthread->in_notmuch) {
-                for (auto &t : mathjax_only_tags) {
-                  if (mthread->thread->has_tag (t)) {
-                    only_tags_ok = true;
-                    break;
-                  }
-                }
-              } else {
-                /* enable for messages not in db */
-                only_tags_ok = true;
-              }
-            } else {
+    /* load mathjax if enabled */
+    if (enable_mathjax) {
+      bool only_tags_ok = false;
+      if (mathjax_only_tags.size () > 0) {
+        if (mthread->in_notmuch) {
+          for (auto &t : mathjax_only_tags) {
+            if (mthread->thread->has_tag (t)) {
               only_tags_ok = true;
+              break;
             }
+          }
+        } else {
+          /* enable for messages not in db */
+          only_tags_ok = true;
+        }
+      } else {
+        only_tags_ok = true;
+      }
 
-            if (only_tags_ok) {
-              math_is_on = true;
-
-              WebKitDOMElement * me = webkit_dom_document_create_element (d, "SCRIPT", (err = NULL, &err));
+      if (only_tags_ok) {
+        math_is_on = true;
 
-              ustring mathjax_uri = mathjax_uri_prefix + "MathJax.js";
+        if (!view->mathjax) {
+          WebKitDOMElement * me = DomUtils::create_element (d, "SCRIPT", (err = NULL, &err));
 
-              webkit_dom_element_set_attribute (me, "type", "text/javascript",
-                  (err = NULL, &err));
-              webkit_dom_element_set_attribute (me, "src", mathjax_uri.c_str(),
-                  (err = NULL, &err));
+          ustring mathjax_uri = mathjax_uri_prefix + "MathJax.js";
 
-              webkit_dom_node_append_child (WEBKIT_DOM_NODE(head), WEBKIT_DOM_NODE(me), (err = NULL, &err));
+          DomUtils::set_attribute (me, "type", "text/javascript",
+              (err = NULL, &err));
+          DomUtils::set_attribute (me, "src", mathjax_uri.c_str(),
+              (err = NULL, &err));
 
+          DomUtils::append_child (WEBKIT_DOM_NODE(head), WEBKIT_DOM_NODE(me), (err = NULL, &err));
 
-              g_object_unref (me);
-            }
-          }
+          g_object_unref (me);
+          view->mathjax = true;
+        }
+      }
+    }
 
-          /* load code_prettify if enabled */
-          if (enable_code_prettify) {
-            bool only_tags_ok = false;
-            if (code_prettify_only_tags.size () > 0) {
-              if (mthread->in_notmuch) {
-                for (auto &t : code_prettify_only_tags) {
-                  if (mthread->thread->has_tag (t)) {
-                    only_tags_ok = true;
-                    break;
-                  }
-                }
-              } else {
-                /* enable for messages not in db */
-                only_tags_ok = true;
-              }
-            } else {
+    /* load code_prettify if enabled */
+    if (enable_code_prettify) {
+      bool only_tags_ok = false;
+      if (code_prettify_only_tags.size () > 0) {
+        if (mthread->in_notmuch) {
+          for (auto &t : code_prettify_only_tags) {
+            if (mthread->thread->has_tag (t)) {
               only_tags_ok = true;
+              break;
             }
+          }
+        } else {
+          /* enable for messages not in db */
+          only_tags_ok = true;
+        }
+      } else {
+        only_tags_ok = true;
+      }
 
-            if (only_tags_ok) {
-              code_is_on = true;
-
-              WebKitDOMElement * me = webkit_dom_document_create_element (d, "SCRIPT", (err = NULL, &err));
-
-              webkit_dom_element_set_attribute (me, "type", "text/javascript",
-                  (err = NULL, &err));
-              webkit_dom_element_set_attribute (me, "src", code_prettify_uri.c_str(),
-                  (err = NULL, &err));
-
-              webkit_dom_node_append_child (WEBKIT_DOM_NODE(head), WEBKIT_DOM_NODE(me), (err = NULL, &err));
+      if (only_tags_ok) {
+        code_is_on = true;
 
+        if (!view->code_prettify) {
+          WebKitDOMElement * me = DomUtils::create_element (d, "SCRIPT", (err = NULL, &err));
 
-              g_object_unref (me);
-            }
-          }
+          DomUtils::set_attribute (me, "type", "text/javascript",
+              (err = NULL, &err));
+          DomUtils::set_attribute (me, "src", code_prettify_uri.c_str(),
+              (err = NULL, &err));
 
-          /* get container for message divs */
-          container = WEBKIT_DOM_HTML_DIV_ELEMENT(webkit_dom_document_get_element_by_id (d, "message_container"));
+          DomUtils::append_child (WEBKIT_DOM_NODE(head), WEBKIT_DOM_NODE(me), (err = NULL, &err));
 
-          if (container == NULL) {
-            log << warn << "render: could not find container!" << endl;
-          }
+          g_object_unref (me);
+          view->code_prettify = true;
+        }
+      }
+    }
 
+    /* get container for message divs */
+    if (container == NULL) {
+      container = WEBKIT_DOM_HTML_DIV_ELEMENT(DomUtils::get_element_by_id (d, "message_container"));
+    }
 
-          g_object_unref (d);
-          g_object_unref (e);
-          g_object_unref (t);
-          g_object_unref (head);
+    if (container == NULL) {
+      log << warn << "render: could not find container!" << endl;
+    } else {
+      DomUtils::set_inner_html (WEBKIT_DOM_HTML_ELEMENT (container), "", (err = NULL, &err));
+    }
 
-          /* render */
-          wk_loaded = true;
-          render_messages ();
+    g_object_unref (d);
+    g_object_unref (head);
 
-        }
-      default:
-        break;
-    }
+    scroll.get_vadjustment ()->set_value (0);
 
-    return true;
+    /* render */
+    wk_loaded = true;
+    render_messages ();
   }
 
   void ThreadView::load_thread (refptr<NotmuchThread> _thread) {
@@ -605,11 +614,27 @@ namespace Astroid {
     Db db (Db::DbMode::DATABASE_READ_ONLY);
 
     auto _mthread = refptr<MessageThread>(new MessageThread (thread));
-    _mthread->load_messages (&db);
-    load_message_thread (_mthread);
+    _mthread->subject = thread->subject;
+
+    /* the messages are rendered as they are loaded, see on_message_loaded */
+    loaded_messages.clear ();
+    message_stubs    = message_loader.start (&db, thread->thread_id);
+    pending_messages = message_stubs.size ();
+    streaming        = true;
+
+    show_message_thread (_mthread);
   }
 
   void ThreadView::load_message_thread (refptr<MessageThread> _mthread) {
+    /* messages are already loaded */
+    message_loader.stop ();
+    streaming = false;
+
+    show_message_thread (_mthread);
+  }
+
+  void ThreadView::show_message_thread (refptr<MessageThread> _mthread) {
+    disconnect_message_changed ();
     mthread = _mthread;
 
     ustring s = mthread->subject;
@@ -626,7 +651,13 @@ namespace Astroid {
   {
     if (!edit_mode) { // edit mode doesn't show tags
       if (me == Message::MessageChangedEvent::MESSAGE_TAGS_CHANGED) {
-        if (m->in_notmuch) {
+        /* only messages that are rendered in this view */
+        bool shown = std::any_of (state.begin (), state.end (),
+            [&] (const std::pair<const refptr<Message>, MessageState> &s) {
+              return s.first.operator-> () == m;
+            });
+
+        if (shown && m->in_notmuch) {
           log << debug << "tv: got message updated." << endl;
           refptr<Message> rm = refptr<Message> (m);
           rm->reference ();
@@ -637,6 +668,18 @@ namespace Astroid {
     }
   }
 
+  void ThreadView::connect_message_changed (refptr<Message> m) {
+    if (edit_mode) return;
+
+    message_changed.push_back (m->signal_message_changed ().connect (
+          sigc::mem_fun (this, &ThreadView::on_message_changed)));
+  }
+
+  void ThreadView::disconnect_message_changed () {
+    for (auto &c : message_changed) c.disconnect ();
+    message_changed.clear ();
+  }
+
   void ThreadView::on_thread_updated (Db * db, ustring thread_id) {
     if (!edit_mode) { // edit mode doesn't show tags
       if (thread && thread_id == thread->thread_id) {
@@ -662,6 +705,29 @@ namespace Astroid {
     }
   }
 
+  void ThreadView::on_refreshed_lastmod (Db * db, unsigned long from, unsigned long to) {
+    if (edit_mode || !thread) return;
+
+    /* check if any messages in this thread have been modified */
+    ustring query_s = ustring::compose ("thread:%1 AND lastmod:%2..%3",
+        thread->thread_id, from, to);
+
+    notmuch_query_t * query = notmuch_query_create (db->nm_db, query_s.c_str ());
+
+    unsigned int c = 0;
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+# ifdef HAVE_QUERY_COUNT_THREADS_ST
+    st = notmuch_query_count_messages_st (query, &c);
+    if (st != NOTMUCH_STATUS_SUCCESS) c = 0;
+# else
+    c = notmuch_query_count_messages (query);
+# endif
+
+    notmuch_query_destroy (query);
+
+    if (c > 0) on_thread_updated (db, thread->thread_id);
+  }
+
   void ThreadView::message_refresh_tags (Db *, refptr<Message> m) {
 
     if (!wk_loaded || !ready) return;
@@ -684,14 +750,19 @@ namespace Astroid {
     ustring mid = "message_" + m->mid;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * div_message = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * div_message = DomUtils::get_element_by_id (d, mid.c_str());
 
+    if (div_message == NULL) {
+      /* not rendered (yet) */
+      g_object_unref (d);
+      return;
+    }
 
     WebKitDOMHTMLElement * tags = DomUtils::select (
         WEBKIT_DOM_NODE (div_message),
         ".header_container .tags");
 
-    webkit_dom_html_element_set_inner_html (tags, tags_s.c_str (), (err = NULL, &err));
+    DomUtils::set_inner_html (tags, tags_s.c_str (), (err = NULL, &err));
 
     g_object_unref (tags);
 
@@ -699,7 +770,7 @@ namespace Astroid {
         WEBKIT_DOM_NODE (div_message),
         ".header_container .header div#Tags .value");
 
-    webkit_dom_html_element_set_inner_html (tags, tags_s.c_str (), (err = NULL, &err));
+    DomUtils::set_inner_html (tags, tags_s.c_str (), (err = NULL, &err));
 
     g_object_unref (tags);
     g_object_unref (div_message);
@@ -712,19 +783,20 @@ namespace Astroid {
 
   /* general message adding and rendering {{{ */
   void ThreadView::render () {
-    log << info << "render: loading html.." << endl;
-    if (container) g_object_unref (container);
-    container = NULL;
-    wk_loaded = false;
-
-    /* home uri used for thread view - request will be relative this
-     * non-existant (hopefully) directory. */
-    home_uri = ustring::compose ("%1/%2",
-        astroid->standard_paths ().config_dir.c_str(),
-        UstringUtils::random_alphanumeric (120));
-
-    webkit_web_view_load_html_string (webview, theme.thread_view_html.c_str (), home_uri.c_str());
-    ready     = false;
+    thumbnail_loader.clear ();
+    wk_loaded  = false;
+    ready      = false;
+    math_is_on = false;
+    code_is_on = false;
+
+    /* the document is kept between threads, if it is still loading the
+     * messages are rendered when it has finished */
+    if (view->loaded) {
+      log << info << "render: reusing document.." << endl;
+      document_ready ();
+    } else {
+      log << info << "render: waiting for html.." << endl;
+    }
   }
 
   void ThreadView::render_messages () {
@@ -734,23 +806,56 @@ namespace Astroid {
       return;
     }
 
+    render_start      = std::chrono::steady_clock::now ();
+    render_operations = DomUtils::operations;
+
     /* set message state vector */
     state.clear ();
+    disconnect_message_changed ();
+
+    if (streaming) {
+      /* show placeholders and the messages loaded so far */
+      insert_placeholders ();
+
+      pending_messages = message_stubs.size ();
+      if (pending_messages == 0) {
+        finish_loaded_messages ();
+        return;
+      }
+
+      for (auto &s : message_stubs) {
+        if (loaded_messages.count (s.mid)) render_loaded_message (s.mid);
+      }
+
+      return;
+    }
 
     for_each (mthread->messages.begin(),
               mthread->messages.end(),
               [&](refptr<Message> m) {
                 add_message (m);
                 state.insert (std::pair<refptr<Message>, MessageState> (m, MessageState ()));
-
-                if (!edit_mode) {
-                  m->signal_message_changed ().connect (
-                      sigc::mem_fun (this, &ThreadView::on_message_changed));
-                }
+                connect_message_changed (m);
               });
 
+    messages_rendered ();
+  }
+
+  void ThreadView::messages_rendered () {
     update_all_indent_states ();
 
+    log << info << "tv: rendered " << mthread->messages.size () << " messages in "
+        << std::chrono::duration_cast<std::chrono::milliseconds> (
+             std::chrono::steady_clock::now () - render_start).count ()
+        << " ms, dom operations: " << (DomUtils::operations - render_operations)
+        << " (batch: " << batch_render << ")" << endl;
+
+    if (mthread->messages.empty ()) {
+      log << warn << "tv: no messages in thread." << endl;
+      emit_ready ();
+      return;
+    }
+
     if (!focused_message) {
       if (!candidate_startup) {
         log << debug << "tv: no message expanded, showing newest message." << endl;
@@ -788,6 +893,163 @@ namespace Astroid {
     emit_ready ();
   }
 
+  void ThreadView::on_message_loaded (ustring mid, refptr<Message> m) {
+    if (!streaming) return;
+
+    loaded_messages[mid] = m;
+
+    if (wk_loaded && container) render_loaded_message (mid);
+  }
+
+  void ThreadView::insert_placeholders () {
+    /* a collapsed message with the fields from the database for every
+     * message that is being loaded */
+    GError * err = NULL;
+
+    for (auto &s : message_stubs) {
+      WebKitDOMNode * insert_before = webkit_dom_node_get_last_child (
+          WEBKIT_DOM_NODE (container));
+
+      WebKitDOMHTMLElement * div_message = DomUtils::make_message_div (webview);
+
+      ustring div_id = "placeholder_" + s.mid;
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT(div_message),
+          "id", div_id.c_str(), (err = NULL, &err));
+
+      WebKitDOMDOMTokenList * class_list =
+        DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(div_message));
+
+      DomUtils::class_list_add (class_list, "hide",
+          (err = NULL, &err));
+
+      g_object_unref (class_list);
+
+      if (indent_messages && s.level > 0) {
+        DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (div_message),
+            "style", ustring::compose ("margin-left: %1px", int(s.level * INDENT_PX)).c_str(), (err = NULL, &err));
+      }
+
+      ustring header;
+      insert_header_address (header, "From", Address(s.sender), true);
+
+      WebKitDOMHTMLElement * table_header = DomUtils::select (
+          WEBKIT_DOM_NODE (div_message),
+          ".header_container .header");
+
+      DomUtils::set_inner_html (table_header, header.c_str(), (err = NULL, &err));
+
+      WebKitDOMHTMLElement * subject = DomUtils::select (
+          WEBKIT_DOM_NODE (div_message),
+          ".header_container .subject");
+
+      ustring sub = Glib::Markup::escape_text (s.subject);
+      if (static_cast<int>(sub.size()) > MAX_PREVIEW_LEN)
+        sub = sub.substr(0, MAX_PREVIEW_LEN - 3) + "...";
+
+      DomUtils::set_inner_html (subject, sub.c_str(), (err = NULL, &err));
+
+      WebKitDOMHTMLElement * preview = DomUtils::select (
+          WEBKIT_DOM_NODE (div_message),
+          ".header_container .preview");
+
+      DomUtils::set_inner_html (preview, "<i>Loading message..</i>", (err = NULL, &err));
+
+      DomUtils::insert_before (WEBKIT_DOM_NODE(container),
+          WEBKIT_DOM_NODE(div_message),
+          insert_before,
+          (err = NULL, &err));
+
+      g_object_unref (preview);
+      g_object_unref (subject);
+      g_object_unref (table_header);
+      g_object_unref (div_message);
+      g_object_unref (insert_before);
+    }
+  }
+
+  void ThreadView::render_loaded_message (ustring mid) {
+    /* replace the placeholder with the loaded message */
+    GError * err = NULL;
+
+    ustring div_id = "placeholder_" + mid;
+
+    WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
+    WebKitDOMElement * placeholder = DomUtils::get_element_by_id (d, div_id.c_str());
+
+    if (placeholder == NULL) {
+      g_object_unref (d);
+      return;
+    }
+
+    refptr<Message> m = loaded_messages[mid];
+
+    if (m) {
+      add_message (m, WEBKIT_DOM_NODE (placeholder));
+      update_indent_state (m);
+
+      state.insert (std::pair<refptr<Message>, MessageState> (m, MessageState ()));
+      connect_message_changed (m);
+
+      DomUtils::remove_child (WEBKIT_DOM_NODE (container),
+          WEBKIT_DOM_NODE (placeholder), (err = NULL, &err));
+
+    } else {
+      /* keep the placeholder, so that the message does not silently
+       * disappear from the thread */
+      log << error << "tv: could not load message: " << mid << endl;
+
+      ustring failed_id = "failed_" + mid;
+      DomUtils::set_attribute (placeholder,
+          "id", failed_id.c_str (), (err = NULL, &err));
+
+      WebKitDOMHTMLElement * preview = DomUtils::select (
+          WEBKIT_DOM_NODE (placeholder),
+          ".header_container .preview");
+
+      DomUtils::set_inner_html (preview,
+          "<i>Could not load message, see log for details.</i>", (err = NULL, &err));
+
+      g_object_unref (preview);
+    }
+
+    g_object_unref (placeholder);
+    g_object_unref (d);
+
+    if (--pending_messages == 0) finish_loaded_messages ();
+  }
+
+  void ThreadView::finish_loaded_messages () {
+    log << debug << "tv: all messages loaded." << endl;
+
+    mthread->messages.clear ();
+    for (auto &s : message_stubs) {
+      refptr<Message> m = loaded_messages[s.mid];
+      if (m) mthread->messages.push_back (m);
+    }
+
+    streaming = false;
+    loaded_messages.clear ();
+
+    /* the messages were added in load order, find the messages to focus
+     * and expand in thread order as add_message would. */
+    if (!edit_mode) {
+      focused_message.reset ();
+      candidate_startup.reset ();
+
+      for (auto &m : mthread->messages) {
+        bool unread = has (m->tags, ustring("unread"));
+
+        if (!candidate_startup && (unread || has (m->tags, ustring("flagged"))))
+          candidate_startup = m;
+
+        if (!focused_message && unread)
+          focused_message = m;
+      }
+    }
+
+    messages_rendered ();
+  }
+
   void ThreadView::update_all_indent_states () {
     for (auto &m : mthread->messages) {
       update_indent_state (m);
@@ -800,14 +1062,14 @@ namespace Astroid {
     GError * err = NULL;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     /* set indentation based on level */
     if (indent_messages && m->level > 0) {
-      webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (e),
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (e),
           "style", ustring::compose ("margin-left: %1px", int(m->level * INDENT_PX)).c_str(), (err = NULL, &err));
     } else {
-      webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (e), "style");
+      DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (e), "style");
     }
 
     g_object_unref (e);
@@ -815,59 +1077,69 @@ namespace Astroid {
 
   }
 
-  void ThreadView::add_message (refptr<Message> m) {
+  void ThreadView::add_message (refptr<Message> m, WebKitDOMNode * insert_before) {
     log << debug << "tv: adding message: " << m->mid << endl;
 
-    ustring div_id = "message_" + m->mid;
+    if (insert_before == NULL) {
+      insert_before = webkit_dom_node_get_last_child (
+          WEBKIT_DOM_NODE (container));
+    } else {
+      g_object_ref (insert_before);
+    }
 
-    WebKitDOMNode * insert_before = webkit_dom_node_get_last_child (
-        WEBKIT_DOM_NODE (container));
+    bool hide = !edit_mode &&
+      !(has (m->tags, ustring("unread")) || has(m->tags, ustring("flagged")));
 
-    WebKitDOMHTMLElement * div_message = DomUtils::make_message_div (webview);
+    if (batch_render) {
+      /* build the complete message and insert it at once */
+      DomUtils::insert_html (WEBKIT_DOM_HTML_ELEMENT (insert_before),
+          "beforebegin", message_html (m, hide));
 
-    GError * err = NULL;
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT(div_message),
-        "id", div_id.c_str(), &err);
+    } else {
+      WebKitDOMHTMLElement * div_message = DomUtils::make_message_div (webview);
 
-    /* insert message div */
-    webkit_dom_node_insert_before (WEBKIT_DOM_NODE(container),
-        WEBKIT_DOM_NODE(div_message),
-        insert_before,
-        (err = NULL, &err));
+      ustring div_id = "message_" + m->mid;
 
-    set_message_html (m, div_message);
+      GError * err = NULL;
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT(div_message),
+          "id", div_id.c_str(), &err);
 
-    /* insert mime messages */
-    if (!m->missing_content) {
-      insert_mime_messages (m, div_message);
-    }
+      /* insert message div */
+      DomUtils::insert_before (WEBKIT_DOM_NODE(container),
+          WEBKIT_DOM_NODE(div_message),
+          insert_before,
+          (err = NULL, &err));
 
-    /* insert attachments */
-    if (!m->missing_content) {
-      bool has_attachment = insert_attachments (m, div_message);
+      set_message_html (m, div_message);
 
       /* add attachment icon */
-      if (has_attachment) {
+      if (!m->missing_content && !m->attachments ().empty ()) {
         set_attachment_icon (m, div_message);
       }
-    }
 
-    /* marked */
-    load_marked_icon (m, div_message);
-
-    if (!edit_mode) {
-      /* optionally hide / collapse the message */
-      if (!(has (m->tags, ustring("unread")) || has(m->tags, ustring("flagged")))) {
+      /* marked */
+      load_marked_icon (m, div_message);
 
+      if (hide) {
         /* hide message */
         WebKitDOMDOMTokenList * class_list =
-          webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(div_message));
+          DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(div_message));
 
-        webkit_dom_dom_token_list_add (class_list, "hide",
+        DomUtils::class_list_add (class_list, "hide",
             (err = NULL, &err));
 
         g_object_unref (class_list);
-      } else {
+      }
+
+      g_object_unref (div_message);
+    }
+
+    /* the body of a collapsed message is rendered when it is expanded */
+    if (!hide) render_message_body (m);
+
+    if (!edit_mode) {
+      /* optionally hide / collapse the message */
+      if (!hide) {
         if (!candidate_startup)
           candidate_startup = m;
       }
@@ -883,91 +1155,226 @@ namespace Astroid {
     }
 
     g_object_unref (insert_before);
-    g_object_unref (div_message);
   } // }}}
 
-  /* main message generation {{{ */
-  void ThreadView::set_message_html (
-      refptr<Message> m,
-      WebKitDOMHTMLElement * div_message)
-  {
-    GError *err;
+  /* main message generation {{{ */
+  ustring ThreadView::message_html (refptr<Message> m, bool hide) {
+    /* the complete message, without body, mime messages and attachments.
+     *
+     * this must have the same structure as #email_template in the
+     * thread view html (ui-version 3). */
+    ustring classes = "email";
+    if (hide) classes += " hide";
 
-    /* load message into div */
+    bool has_attachments = !m->missing_content && !m->attachments ().empty ();
+    if (has_attachments) classes += " attachment";
+
+    ustring style;
+    if (indent_messages && m->level > 0) {
+      style = ustring::compose (" style=\"margin-left: %1px\"", int(m->level * INDENT_PX));
+    }
+
+    ustring warning = message_warning (m);
+    ustring tags    = m->in_notmuch ? tags_html (m) : "";
+
+    ustring attachment_icon_src = has_attachments ? ustring (attachment_icon_uri) : "";
+
+    ustring body;
+    if (m->missing_content) {
+      body = "<span class=\"body_part\"><i>Message content is missing.</i></span>";
+    }
+
+    ustring html = ustring::compose (
+        "<div id=\"%1\" class=\"%2\"%3>"
+          "<div class=\"compressed_note\"><span></span></div>"
+          "<div class=\"geary_spacer\"></div>"
+          "<div class=\"email_container\">"
+            "<div class=\"email_warning%4\">%5</div>"
+            "<div class=\"email_info\"></div>"
+            "<div class=\"header_container\">"
+              "<img src=\"%6\" class=\"avatar\" />"
+              "<div class=\"button_bar\"></div>",
+        Glib::Markup::escape_text ("message_" + m->mid),
+        classes,
+        style,
+        (warning.empty () ? "" : " show"),
+        warning,
+        Glib::Markup::escape_text (avatar_uri (m)));
+
+    html += ustring::compose (
+              "<img src=\"%1\" class=\"attachment icon first\" />"
+              "<img src=\"%2\" class=\"marked icon first\" />"
+              "<div class=\"header\">%3</div>"
+              "<img src=\"%1\" class=\"attachment icon sec\" />"
+              "<img src=\"%2\" class=\"marked icon sec\" />"
+              "<div class=\"tags\">%4</div>"
+              "<div class=\"subject\">%5</div>"
+              "<div class=\"preview\">%6</div>"
+            "</div>",
+        attachment_icon_src,
+        marked_icon_uri,
+        header_html (m, tags),
+        tags,
+        subject_html (m),
+        preview_html (m));
+
+    html += ustring::compose (
+            "<div class=\"remote_images\"><img class=\"close_show_images button\" /></div>"
+            "<div class=\"body\">%1</div>"
+            "<div class=\"draft_edit\"><span class=\"draft_edit_button button\"></span></div>"
+          "</div>"
+        "</div>",
+        body);
+
+    return html;
+  }
+
+  ustring ThreadView::header_html (refptr<Message> m, ustring tags) {
     ustring header;
-    WebKitDOMHTMLElement * div_email_container =
-      DomUtils::select (WEBKIT_DOM_NODE(div_message), "div.email_container");
 
-    /* build header */
     insert_header_address (header, "From", Address(m->sender), true);
 
-    insert_header_address_list (header, "To", AddressList(m->to()), false);
+    insert_header_address_list (header, "To", m->to (), false);
 
-    if (internet_address_list_length (m->cc()) > 0) {
-      insert_header_address_list (header, "Cc", AddressList(m->cc()), false);
+    AddressList cc = m->cc ();
+    if (cc.size () > 0) {
+      insert_header_address_list (header, "Cc", cc, false);
     }
 
-    if (internet_address_list_length (m->bcc()) > 0) {
-      insert_header_address_list (header, "Bcc", AddressList(m->bcc()), false);
+    AddressList bcc = m->bcc ();
+    if (bcc.size () > 0) {
+      insert_header_address_list (header, "Bcc", bcc, false);
     }
 
     insert_header_date (header, m);
 
     if (m->subject.length() > 0) {
       insert_header_row (header, "Subject", m->subject, false);
-
-      WebKitDOMHTMLElement * subject = DomUtils::select (
-          WEBKIT_DOM_NODE (div_message),
-          ".header_container .subject");
-
-      ustring s = Glib::Markup::escape_text(m->subject);
-      if (static_cast<int>(s.size()) > MAX_PREVIEW_LEN)
-        s = s.substr(0, MAX_PREVIEW_LEN - 3) + "...";
-
-      webkit_dom_html_element_set_inner_html (subject, s.c_str(), (err = NULL, &err));
-
-      g_object_unref (subject);
     }
 
     if (m->in_notmuch) {
-      unsigned char cv[] = { 0xff, 0xff, 0xff };
-      ustring tags_s;
+      header += create_header_row ("Tags", tags, false, false, true);
+    }
+
+    return header;
+  }
+
+  ustring ThreadView::tags_html (refptr<Message> m) {
+    unsigned char cv[] = { 0xff, 0xff, 0xff };
+    ustring tags_s;
 
 # ifndef DISABLE_PLUGINS
-      if (!plugins->format_tags (m->tags, "#ffffff", false, tags_s)) {
+    if (!plugins->format_tags (m->tags, "#ffffff", false, tags_s)) {
 #  endif
-        tags_s = VectorUtils::concat_tags_color (m->tags, false, 0, cv);
+      tags_s = VectorUtils::concat_tags_color (m->tags, false, 0, cv);
 # ifndef DISABLE_PLUGINS
-      }
+    }
+# endif
+
+    return tags_s;
+  }
+
+  ustring ThreadView::subject_html (refptr<Message> m) {
+    ustring s = Glib::Markup::escape_text(m->subject);
+    if (static_cast<int>(s.size()) > MAX_PREVIEW_LEN)
+      s = s.substr(0, MAX_PREVIEW_LEN - 3) + "...";
+
+    return s;
+  }
+
+  ustring ThreadView::avatar_uri (refptr<Message> m) {
+    ustring uri = "";
+    auto se = Address(m->sender);
+# ifdef DISABLE_PLUGINS
+    if (false) {
+# else
+    if (plugins->get_avatar_uri (se.email (), Gravatar::DefaultStr[Gravatar::Default::RETRO], 48, m, uri)) {
 # endif
+      ; // all fine, use plugins avatar
+    } else {
+      if (enable_gravatar) {
+        uri = Gravatar::get_image_uri (se.email (),Gravatar::Default::RETRO , 48);
+      }
+    }
+
+    return uri;
+  }
+
+  ustring ThreadView::message_warning (refptr<Message> m) {
+    if (m->missing_content) {
+      return "The message file is missing, only fields cached in the notmuch database are shown. Most likely your database is out of sync.";
+    }
+
+    if (!edit_mode &&
+         any_of (Db::draft_tags.begin (),
+                 Db::draft_tags.end (),
+                 [&](ustring t) {
+                   return has (m->tags, t);
+                 }))
+    {
+      return "This message is a draft, edit it with E or delete with D.";
+    }
+
+    return "";
+  }
+
+  ustring ThreadView::preview_html (refptr<Message> m) {
+    if (m->missing_content) {
+      return "<i>Message content is missing.</i>";
+    }
+
+    log << debug << "tv: make preview.." << endl;
+
+    ustring bp = m->viewable_text (false, false);
+    if (static_cast<int>(bp.size()) > MAX_PREVIEW_LEN)
+      bp = bp.substr(0, MAX_PREVIEW_LEN - 3) + "...";
+
+    while (true) {
+      size_t i = bp.find ("<br>");
+
+      if (i == ustring::npos) break;
 
-      header += create_header_row ("Tags", tags_s, false, false, true);
+      bp.erase (i, 4);
+    }
+
+    return Glib::Markup::escape_text (bp);
+  }
+
+  void ThreadView::set_message_html (
+      refptr<Message> m,
+      WebKitDOMHTMLElement * div_message)
+  {
+    GError *err;
+
+    /* load message into div */
+    WebKitDOMHTMLElement * div_email_container =
+      DomUtils::select (WEBKIT_DOM_NODE(div_message), "div.email_container");
+
+    ustring tags_s = m->in_notmuch ? tags_html (m) : "";
 
+    if (m->subject.length() > 0) {
+      WebKitDOMHTMLElement * subject = DomUtils::select (
+          WEBKIT_DOM_NODE (div_message),
+          ".header_container .subject");
+
+      DomUtils::set_inner_html (subject, subject_html (m).c_str(), (err = NULL, &err));
+
+      g_object_unref (subject);
+    }
 
+    if (m->in_notmuch) {
       WebKitDOMHTMLElement * tags = DomUtils::select (
           WEBKIT_DOM_NODE (div_message),
           ".header_container .tags");
 
-      webkit_dom_html_element_set_inner_html (tags,tags_s.c_str(), (err = NULL, &err));
+      DomUtils::set_inner_html (tags,tags_s.c_str(), (err = NULL, &err));
 
       g_object_unref (tags);
     }
 
     /* avatar */
     {
-      ustring uri = "";
-      auto se = Address(m->sender);
-# ifdef DISABLE_PLUGINS
-      if (false) {
-# else
-      if (plugins->get_avatar_uri (se.email (), Gravatar::DefaultStr[Gravatar::Default::RETRO], 48, m, uri)) {
-# endif
-        ; // all fine, use plugins avatar
-      } else {
-        if (enable_gravatar) {
-          uri = Gravatar::get_image_uri (se.email (),Gravatar::Default::RETRO , 48);
-        }
-      }
+      ustring uri = avatar_uri (m);
 
       if (!uri.empty ()) {
         WebKitDOMHTMLImageElement * av = WEBKIT_DOM_HTML_IMAGE_ELEMENT (
@@ -975,7 +1382,7 @@ namespace Astroid {
             WEBKIT_DOM_NODE (div_message),
             ".avatar"));
 
-        webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (av), "src",
+        DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (av), "src",
             uri.c_str (),
             (err = NULL, &err));
 
@@ -988,91 +1395,81 @@ namespace Astroid {
       DomUtils::select (WEBKIT_DOM_NODE(div_email_container),
           ".header_container .header");
 
-    webkit_dom_html_element_set_inner_html (
+    DomUtils::set_inner_html (
         table_header,
-        header.c_str(),
+        header_html (m, tags_s).c_str(),
         (err = NULL, &err));
 
-    /* if message is missing body, set warning and don't add any content */
-
-    WebKitDOMHTMLElement * span_body =
-      DomUtils::select (WEBKIT_DOM_NODE(div_email_container), ".body");
+    /* draft or missing content warning */
+    ustring warning = message_warning (m);
+    if (!warning.empty ()) set_warning (m, warning);
 
     WebKitDOMHTMLElement * preview = DomUtils::select (
         WEBKIT_DOM_NODE (div_message),
         ".header_container .preview");
 
-    {
-      if (!edit_mode &&
-           any_of (Db::draft_tags.begin (),
-                   Db::draft_tags.end (),
-                   [&](ustring t) {
-                     return has (m->tags, t);
-                   }))
-      {
-
-        /* set warning */
-        set_warning (m, "This message is a draft, edit it with E or delete with D.");
-
-      }
-    }
+    DomUtils::set_inner_html (preview, preview_html (m).c_str(), (err = NULL, &err));
 
+    /* if message is missing body, add an explanation to the body */
     if (m->missing_content) {
-      /* set preview */
-      webkit_dom_html_element_set_inner_html (preview, "<i>Message content is missing.</i>", (err = NULL, &err));
-
-      /* set warning */
-      set_warning (m, "The message file is missing, only fields cached in the notmuch database are shown. Most likely your database is out of sync.");
-
-      /* add an explenation to the body */
-      GError *err;
+      WebKitDOMHTMLElement * span_body =
+        DomUtils::select (WEBKIT_DOM_NODE(div_email_container), ".body");
 
       WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
       WebKitDOMHTMLElement * body_container =
         DomUtils::clone_select (WEBKIT_DOM_NODE(d), "#body_template");
 
-      webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (body_container),
+      DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (body_container),
           "id");
 
-      webkit_dom_html_element_set_inner_html (
+      DomUtils::set_inner_html (
           body_container,
           "<i>Message content is missing.</i>",
           (err = NULL, &err));
 
-      webkit_dom_node_append_child (WEBKIT_DOM_NODE (span_body),
+      DomUtils::append_child (WEBKIT_DOM_NODE (span_body),
           WEBKIT_DOM_NODE (body_container), (err = NULL, &err));
 
       g_object_unref (body_container);
       g_object_unref (d);
+      g_object_unref (span_body);
+    }
 
-    } else {
+    g_object_unref (preview);
+    g_object_unref (table_header);
+    g_object_unref (div_email_container);
+  }
+
+  void ThreadView::render_message_body (refptr<Message> m) {
+    /* insert the body, mime messages and attachments of the message */
+    if (state[m].rendered) return;
+    state[m].rendered = true;
 
-      /* build message body */
-      create_message_part_html (m, m->root, span_body, true);
+    if (m->missing_content) return;
 
-      /* preview */
-      log << debug << "tv: make preview.." << endl;
+    log << debug << "tv: rendering body: " << m->mid << endl;
 
-      ustring bp = m->viewable_text (false, false);
-      if (static_cast<int>(bp.size()) > MAX_PREVIEW_LEN)
-        bp = bp.substr(0, MAX_PREVIEW_LEN - 3) + "...";
+    ustring div_id = "message_" + m->mid;
 
-      while (true) {
-        size_t i = bp.find ("<br>");
+    WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
+    WebKitDOMHTMLElement * div_message = WEBKIT_DOM_HTML_ELEMENT (
+        DomUtils::get_element_by_id (d, div_id.c_str()));
 
-        if (i == ustring::npos) break;
+    WebKitDOMHTMLElement * span_body =
+      DomUtils::select (WEBKIT_DOM_NODE(div_message), "div.email_container .body");
 
-        bp.erase (i, 4);
-      }
+    /* build message body */
+    create_message_part_html (m, m->root, span_body, true);
 
-      bp = Glib::Markup::escape_text (bp);
+    /* insert mime messages */
+    insert_mime_messages (m, div_message);
 
-      webkit_dom_html_element_set_inner_html (preview, bp.c_str(), (err = NULL, &err));
-    }
+    /* insert attachments */
+    insert_attachments (m, div_message);
 
-    g_object_unref (preview);
     g_object_unref (span_body);
-    g_object_unref (table_header);
+    g_object_unref (div_message);
+    g_object_unref (d);
   } // }}}
 
   /* generating message parts {{{ */
@@ -1141,7 +1538,7 @@ namespace Astroid {
     WebKitDOMHTMLElement * body_container =
       DomUtils::clone_select (WEBKIT_DOM_NODE(d), "#body_template");
 
-    webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (body_container),
+    DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (body_container),
         "id");
 
     ustring body = c->viewable_text (true, true);
@@ -1157,7 +1554,7 @@ namespace Astroid {
       }
     }
 
-    webkit_dom_html_element_set_inner_html (
+    DomUtils::set_inner_html (
         body_container,
         body.c_str(),
         (err = NULL, &err));
@@ -1171,7 +1568,7 @@ namespace Astroid {
       WebKitDOMHTMLElement * encrypt_container =
         DomUtils::clone_select (WEBKIT_DOM_NODE(d), "#encrypt_template");
 
-      webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (encrypt_container),
+      DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (encrypt_container),
           "id");
 
       // add to message state
@@ -1179,12 +1576,12 @@ namespace Astroid {
       state[message].elements.push_back (e);
       log << debug << "tv: added encrypt: " << c->id << endl;
 
-      webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (encrypt_container),
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (encrypt_container),
         "id", e.element_id().c_str(),
         (err = NULL, &err));
 
       WebKitDOMDOMTokenList * class_list_e =
-        webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(encrypt_container));
+        DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(encrypt_container));
 
 
 
@@ -1304,44 +1701,44 @@ namespace Astroid {
       WebKitDOMHTMLElement * message_cont =
         DomUtils::select (WEBKIT_DOM_NODE (encrypt_container), ".message");
 
-      webkit_dom_html_element_set_inner_html (
+      DomUtils::set_inner_html (
           message_cont,
           content.c_str(),
           (err = NULL, &err));
 
 
-      webkit_dom_node_append_child (WEBKIT_DOM_NODE (span_body),
+      DomUtils::append_child (WEBKIT_DOM_NODE (span_body),
           WEBKIT_DOM_NODE (encrypt_container), (err = NULL, &err));
 
       /* add encryption tag to encrypted part */
       WebKitDOMDOMTokenList * class_list =
-        webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(body_container));
+        DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(body_container));
 
       if (c->isencrypted) {
-        webkit_dom_dom_token_list_add (class_list_e, "encrypted",
+        DomUtils::class_list_add (class_list_e, "encrypted",
             (err = NULL, &err));
-        webkit_dom_dom_token_list_add (class_list, "encrypted",
+        DomUtils::class_list_add (class_list, "encrypted",
             (err = NULL, &err));
 
         if (!c->crypt->decrypted) {
-          webkit_dom_dom_token_list_add (class_list_e, "decrypt_failed",
+          DomUtils::class_list_add (class_list_e, "decrypt_failed",
               (err = NULL, &err));
-          webkit_dom_dom_token_list_add (class_list, "decrypt_failed",
+          DomUtils::class_list_add (class_list, "decrypt_failed",
               (err = NULL, &err));
         }
       }
 
       if (c->issigned) {
-        webkit_dom_dom_token_list_add (class_list_e, "signed",
+        DomUtils::class_list_add (class_list_e, "signed",
             (err = NULL, &err));
 
-        webkit_dom_dom_token_list_add (class_list, "signed",
+        DomUtils::class_list_add (class_list, "signed",
             (err = NULL, &err));
 
         if (!c->crypt->verified) {
-          webkit_dom_dom_token_list_add (class_list_e, "verify_failed",
+          DomUtils::class_list_add (class_list_e, "verify_failed",
               (err = NULL, &err));
-          webkit_dom_dom_token_list_add (class_list, "verify_failed",
+          DomUtils::class_list_add (class_list, "verify_failed",
               (err = NULL, &err));
         }
       }
@@ -1353,7 +1750,7 @@ namespace Astroid {
 
     }
 
-    webkit_dom_node_append_child (WEBKIT_DOM_NODE (span_body),
+    DomUtils::append_child (WEBKIT_DOM_NODE (span_body),
         WEBKIT_DOM_NODE (body_container), (err = NULL, &err));
 
     g_object_unref (body_container);
@@ -1413,7 +1810,7 @@ namespace Astroid {
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
     ustring mid = "message_" + message->mid;
 
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     WebKitDOMHTMLElement * div_email_container =
       DomUtils::select (WEBKIT_DOM_NODE(e), "div.email_container");
@@ -1422,9 +1819,9 @@ namespace Astroid {
       DomUtils::select (WEBKIT_DOM_NODE(div_email_container), ".body");
 
     WebKitDOMElement * sibling =
-      webkit_dom_document_get_element_by_id (d, el.element_id().c_str());
+      DomUtils::get_element_by_id (d, el.element_id().c_str());
 
-    webkit_dom_node_remove_child (WEBKIT_DOM_NODE (span_body),
+    DomUtils::remove_child (WEBKIT_DOM_NODE (span_body),
         WEBKIT_DOM_NODE(sibling), (err = NULL, &err));
 
     state[message].elements.erase (
@@ -1472,7 +1869,7 @@ namespace Astroid {
     WebKitDOMHTMLElement * sibling_container =
       DomUtils::clone_select (WEBKIT_DOM_NODE(d), "#sibling_template");
 
-    webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (sibling_container),
+    DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (sibling_container),
         "id");
 
     // add to message state
@@ -1480,7 +1877,7 @@ namespace Astroid {
     state[message].elements.push_back (e);
     log << debug << "tv: added sibling: " << state[message].elements.size() << endl;
 
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (sibling_container),
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (sibling_container),
       "id", e.element_id().c_str(),
       (err = NULL, &err));
 
@@ -1491,13 +1888,13 @@ namespace Astroid {
     WebKitDOMHTMLElement * message_cont =
       DomUtils::select (WEBKIT_DOM_NODE (sibling_container), ".message");
 
-    webkit_dom_html_element_set_inner_html (
+    DomUtils::set_inner_html (
         message_cont,
         content.c_str(),
         (err = NULL, &err));
 
 
-    webkit_dom_node_append_child (WEBKIT_DOM_NODE (span_body),
+    DomUtils::append_child (WEBKIT_DOM_NODE (span_body),
         WEBKIT_DOM_NODE (sibling_container), (err = NULL, &err));
 
     g_object_unref (message_cont);
@@ -1512,19 +1909,19 @@ namespace Astroid {
     ustring mid = "message_" + m->mid;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     WebKitDOMHTMLElement * warning = DomUtils::select (
         WEBKIT_DOM_NODE (e),
         ".email_warning");
 
     GError * err;
-    webkit_dom_html_element_set_inner_html (warning, txt.c_str(), (err = NULL, &err));
+    DomUtils::set_inner_html (warning, txt.c_str(), (err = NULL, &err));
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(warning));
+      DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(warning));
 
-    webkit_dom_dom_token_list_add (class_list, "show",
+    DomUtils::class_list_add (class_list, "show",
         (err = NULL, &err));
 
     g_object_unref (class_list);
@@ -1538,19 +1935,19 @@ namespace Astroid {
     ustring mid = "message_" + m->mid;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     WebKitDOMHTMLElement * warning = DomUtils::select (
         WEBKIT_DOM_NODE (e),
         ".email_warning");
 
     GError * err;
-    webkit_dom_html_element_set_inner_html (warning, "", (err = NULL, &err));
+    DomUtils::set_inner_html (warning, "", (err = NULL, &err));
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(warning));
+      DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(warning));
 
-    webkit_dom_dom_token_list_remove (class_list, "show",
+    DomUtils::class_list_remove (class_list, "show",
         (err = NULL, &err));
 
     g_object_unref (class_list);
@@ -1566,7 +1963,7 @@ namespace Astroid {
     ustring mid = "message_" + m->mid;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     if (e == NULL) {
       log << warn << "tv: could not get email div." << endl;
@@ -1577,12 +1974,12 @@ namespace Astroid {
         ".email_info");
 
     GError * err;
-    webkit_dom_html_element_set_inner_html (info, txt.c_str(), (err = NULL, &err));
+    DomUtils::set_inner_html (info, txt.c_str(), (err = NULL, &err));
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(info));
+      DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(info));
 
-    webkit_dom_dom_token_list_add (class_list, "show",
+    DomUtils::class_list_add (class_list, "show",
         (err = NULL, &err));
 
     g_object_unref (class_list);
@@ -1595,7 +1992,7 @@ namespace Astroid {
     ustring mid = "message_" + m->mid;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     if (e == NULL) {
       log << warn << "tv: could not get email div." << endl;
@@ -1606,12 +2003,12 @@ namespace Astroid {
         ".email_info");
 
     GError * err;
-    webkit_dom_html_element_set_inner_html (info, "", (err = NULL, &err));
+    DomUtils::set_inner_html (info, "", (err = NULL, &err));
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(info));
+      DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(info));
 
-    webkit_dom_dom_token_list_remove (class_list, "show",
+    DomUtils::class_list_remove (class_list, "show",
         (err = NULL, &err));
 
     g_object_unref (class_list);
@@ -1723,16 +2120,11 @@ namespace Astroid {
         WEBKIT_DOM_NODE (div_message),
         ".attachment.icon.first");
 
-    gchar * content;
-    gsize   content_size;
-    attachment_icon->save_to_buffer (content, content_size, "png");
-    ustring image_content_type = "image/png";
-
     WebKitDOMHTMLImageElement *img = WEBKIT_DOM_HTML_IMAGE_ELEMENT (attachment_icon_img);
 
     err = NULL;
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
-        DomUtils::assemble_data_uri (image_content_type, content, content_size).c_str(), &err);
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
+        attachment_icon_uri.c_str(), &err);
 
     g_object_unref (attachment_icon_img);
 
@@ -1742,14 +2134,14 @@ namespace Astroid {
     img = WEBKIT_DOM_HTML_IMAGE_ELEMENT (attachment_icon_img);
 
     err = NULL;
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
-        DomUtils::assemble_data_uri (image_content_type, content, content_size).c_str(), &err);
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
+        attachment_icon_uri.c_str(), &err);
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(div_message));
+      DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(div_message));
 
     /* set class  */
-    webkit_dom_dom_token_list_add (class_list, "attachment",
+    DomUtils::class_list_add (class_list, "attachment",
         (err = NULL, &err));
 
     g_object_unref (class_list);
@@ -1777,6 +2169,14 @@ namespace Astroid {
     //     </table>
     // </div>
 
+    if (batch_render) {
+      ustring html = attachments_html (message);
+      if (html.empty ()) return false;
+
+      DomUtils::insert_html (div_message, "beforeend", html);
+      return true;
+    }
+
     GError *err;
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
@@ -1785,9 +2185,9 @@ namespace Astroid {
     WebKitDOMHTMLElement * attachment_template =
       DomUtils::select (WEBKIT_DOM_NODE(attachment_container), ".attachment");
 
-    webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (attachment_container),
+    DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (attachment_container),
         "id");
-    webkit_dom_node_remove_child (WEBKIT_DOM_NODE (attachment_container),
+    DomUtils::remove_child (WEBKIT_DOM_NODE (attachment_container),
         WEBKIT_DOM_NODE(attachment_template), (err = NULL, &err));
 
     int attachments = 0;
@@ -1809,16 +2209,15 @@ namespace Astroid {
 
       fname = Glib::Markup::escape_text (fname);
 
-      webkit_dom_html_element_set_inner_text (info_fname, fname.c_str(), (err = NULL, &err));
+      DomUtils::set_inner_text (info_fname, fname.c_str(), (err = NULL, &err));
 
       WebKitDOMHTMLElement * info_fsize =
         DomUtils::select (WEBKIT_DOM_NODE (attachment_table), ".info .filesize");
 
-      refptr<Glib::ByteArray> attachment_data = c->contents ();
-
-      ustring fsize = Utils::format_size (attachment_data->size ());
+      size_t sz = c->get_file_size ();
+      ustring fsize = Utils::format_size (sz);
 
-      webkit_dom_html_element_set_inner_text (info_fsize, fsize.c_str(), (err = NULL, &err));
+      DomUtils::set_inner_text (info_fsize, fsize.c_str(), (err = NULL, &err));
 
 
       // add attachment to message state
@@ -1826,10 +2225,10 @@ namespace Astroid {
       state[message].elements.push_back (e);
       log << debug << "tv: added attachment: " << state[message].elements.size() << endl;
 
-      webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (attachment_table),
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (attachment_table),
         "data-attachment-id", e.element_id().c_str(),
         (err = NULL, &err));
-      webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (attachment_table),
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (attachment_table),
         "id", e.element_id().c_str(),
         (err = NULL, &err));
 
@@ -1838,25 +2237,27 @@ namespace Astroid {
         WEBKIT_DOM_HTML_IMAGE_ELEMENT(
         DomUtils::select (WEBKIT_DOM_NODE (attachment_table), ".preview img"));
 
-      set_attachment_src (c, attachment_data, img);
+      set_attachment_src (c, e.element_id (),
+          ThumbnailCache::make_key (message->mid, attachments, sz, THUMBNAIL_WIDTH),
+          img);
 
       // add the attachment table
-      webkit_dom_node_append_child (WEBKIT_DOM_NODE (attachment_container),
+      DomUtils::append_child (WEBKIT_DOM_NODE (attachment_container),
           WEBKIT_DOM_NODE (attachment_table), (err = NULL, &err));
 
 
       if (c->issigned || c->isencrypted) {
         /* add encryption or signed tag to attachment */
         WebKitDOMDOMTokenList * class_list =
-          webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(attachment_table));
+          DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(attachment_table));
 
         if (c->isencrypted) {
-          webkit_dom_dom_token_list_add (class_list, "encrypted",
+          DomUtils::class_list_add (class_list, "encrypted",
               (err = NULL, &err));
         }
 
         if (c->issigned) {
-          webkit_dom_dom_token_list_add (class_list, "signed",
+          DomUtils::class_list_add (class_list, "signed",
               (err = NULL, &err));
         }
 
@@ -1871,7 +2272,7 @@ namespace Astroid {
     }
 
     if (attachments > 0) {
-      webkit_dom_node_append_child (WEBKIT_DOM_NODE (div_message),
+      DomUtils::append_child (WEBKIT_DOM_NODE (div_message),
           WEBKIT_DOM_NODE (attachment_container), (err = NULL, &err));
     }
 
@@ -1882,12 +2283,64 @@ namespace Astroid {
     return (attachments > 0);
   }
 
-  void ThreadView::set_attachment_src (
+  ustring ThreadView::attachments_html (refptr<Message> message) {
+    /* the attachment container with a table for each attachment, must
+     * have the same structure as #attachment_template. */
+    ustring html;
+    int attachments = 0;
+
+    for (refptr<Chunk> &c : message->attachments ()) {
+      attachments++;
+
+      ustring fname = c->get_filename ();
+      if (fname.size () == 0) {
+        fname = "Unnamed attachment";
+      }
+
+      size_t sz = c->get_file_size ();
+
+      // add attachment to message state
+      MessageState::Element e (MessageState::ElementType::Attachment, c->id);
+      state[message].elements.push_back (e);
+
+      ustring classes = "attachment";
+      if (c->isencrypted) classes += " encrypted";
+      if (c->issigned)    classes += " signed";
+
+      bool thumbnail;
+      ustring src = attachment_src (c, e.element_id (),
+          ThumbnailCache::make_key (message->mid, attachments, sz, THUMBNAIL_WIDTH),
+          thumbnail);
+
+      html += ustring::compose (
+          "<table class=\"%1\" data-attachment-id=\"%2\" id=\"%2\"><tr>"
+            "<td class=\"preview\"><img src=\"%3\"%4 /></td>"
+            "<td class=\"info\">"
+              "<div class=\"filename\">%5</div>"
+              "<div class=\"filesize\">%6</div>"
+            "</td>"
+          "</tr></table>",
+          classes,
+          e.element_id (),
+          src,
+          (thumbnail ? " class=\"thumbnail\"" : ""),
+          Glib::Markup::escape_text (fname),
+          Utils::format_size (sz));
+    }
+
+    if (attachments == 0) return "";
+
+    return "<div class=\"attachment_container\"><div class=\"top_border\"></div>" + html + "</div>";
+  }
+
+  ustring ThreadView::attachment_src (
       refptr<Chunk> c,
-      refptr<Glib::ByteArray> data,
-      WebKitDOMHTMLImageElement *img)
+      ustring element_id,
+      ustring key,
+      bool & thumbnail)
   {
-    /* set the preview image or icon on the attachment display element */
+    /* the preview image or icon of an attachment */
+    thumbnail = false;
 
     const char * _mtype = g_mime_content_type_get_media_type (c->content_type);
     ustring mime_type;
@@ -1899,78 +2352,80 @@ namespace Astroid {
 
     log << debug << "tv: set attachment, mime_type: " << mime_type << ", mtype: " << _mtype << endl;
 
-    gchar * content;
-    gsize   content_size;
-    ustring image_content_type;
-
     if ((_mtype != NULL) && (ustring(_mtype) == "image")) {
-      auto mis = Gio::MemoryInputStream::create ();
-      mis->add_data (data->get_data (), data->size ());
-
-      try {
-
-        auto pb = Gdk::Pixbuf::create_from_stream_at_scale (mis, THUMBNAIL_WIDTH, -1, true, refptr<Gio::Cancellable>());
-        pb = pb->apply_embedded_orientation ();
-
-        pb->save_to_buffer (content, content_size, "png");
-        image_content_type = "image/png";
-
-        GError * gerr;
-        WebKitDOMDOMTokenList * class_list =
-          webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(img));
-        /* set class  */
-        webkit_dom_dom_token_list_add (class_list, "thumbnail",
-            (gerr = NULL, &gerr));
+      bfs::path p;
+      if (astroid->thumbnail_cache->get (key, p)) {
+        thumbnail = true;
+        return thumbnail_uri (key);
+      }
 
-        g_object_unref (class_list);
+      /* show the icon until the thumbnail is ready, see on_thumbnail_ready */
+      thumbnail_loader.queue (c, element_id, key);
+    }
 
-      } catch (Gdk::PixbufError &ex) {
+    // TODO: use guessed icon (g_content_type_get_icon)
 
-        log << error << "tv: could not create icon from attachmed image." << endl;
+    return attachment_icon_uri;
+  }
 
-        attachment_icon->save_to_buffer (content, content_size, "png"); // default type is png
-        image_content_type = "image/png";
+  void ThreadView::set_attachment_src (
+      refptr<Chunk> c,
+      ustring element_id,
+      ustring key,
+      WebKitDOMHTMLImageElement *img)
+  {
+    /* set the preview image or icon on the attachment display element */
+    bool thumbnail;
+    ustring src = attachment_src (c, element_id, key, thumbnail);
 
-      }
-    } else {
+    GError * err = NULL;
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
+        src.c_str(), &err);
 
-      /*
-      const char * _gio_content_type = g_content_type_from_mime_type (mime_type.c_str());
-      ustring gio_content_type;
-      if (_gio_content_type == NULL) {
-        gio_content_type = "application/octet-stream";
-      } else {
-        gio_content_type = ustring(_gio_content_type);
-      }
-      GIcon * icon = g_content_type_get_icon (gio_content_type.c_str());
+    if (thumbnail) {
+      WebKitDOMDOMTokenList * class_list =
+        DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(img));
+      /* set class  */
+      DomUtils::class_list_add (class_list, "thumbnail",
+          (err = NULL, &err));
 
-      ustring icon_string;
-      if (icon == NULL) {
-        icon_string = "mail-attachment-symbolic";
-      } else {
-        icon_string = g_icon_to_string (icon);
-        g_object_unref (icon);
-      }
+      g_object_unref (class_list);
+    }
+  }
 
-      if (icon_string.size() < 1) {
-        icon_string = "mail-attachment-symbolic";
-      }
+  ustring ThreadView::thumbnail_uri (ustring key) {
+    return home_uri + "/thumbnails/" + key + ".png";
+  }
 
+  void ThreadView::on_thumbnail_ready (ustring element_id, ustring key, std::string data_uri) {
+    if (!wk_loaded || !container) return;
 
-      log << debug << "icon: " << icon_string << flush << endl;
-      */
+    WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, element_id.c_str ());
 
-      // TODO: use guessed icon
+    if (e == NULL) {
+      g_object_unref (d);
+      return;
+    }
 
-      attachment_icon->save_to_buffer (content, content_size, "png"); // default type is png
-      image_content_type = "image/png";
+    WebKitDOMHTMLElement * img = DomUtils::select (WEBKIT_DOM_NODE (e), ".preview img");
 
-    }
+    ustring uri = data_uri.empty () ? thumbnail_uri (key) : ustring (data_uri);
 
     GError * err = NULL;
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
-        DomUtils::assemble_data_uri (image_content_type, content, content_size).c_str(), &err);
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
+        uri.c_str(), &err);
+
+    WebKitDOMDOMTokenList * class_list =
+      DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(img));
+    /* set class  */
+    DomUtils::class_list_add (class_list, "thumbnail",
+        (err = NULL, &err));
 
+    g_object_unref (class_list);
+    g_object_unref (img);
+    g_object_unref (e);
+    g_object_unref (d);
   }
   /* attachments end }}} */
 
@@ -1985,16 +2440,11 @@ namespace Astroid {
         WEBKIT_DOM_NODE (div_message),
         ".marked.icon.first");
 
-    gchar * content;
-    gsize   content_size;
-    marked_icon->save_to_buffer (content, content_size, "png");
-    ustring image_content_type = "image/png";
-
     WebKitDOMHTMLImageElement *img = WEBKIT_DOM_HTML_IMAGE_ELEMENT (marked_icon_img);
 
     err = NULL;
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
-        DomUtils::assemble_data_uri (image_content_type, content, content_size).c_str(), &err);
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
+        marked_icon_uri.c_str(), &err);
 
     g_object_unref (marked_icon_img);
     marked_icon_img = DomUtils::select (
@@ -2002,8 +2452,8 @@ namespace Astroid {
         ".marked.icon.sec");
     img = WEBKIT_DOM_HTML_IMAGE_ELEMENT (marked_icon_img);
     err = NULL;
-    webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
-        DomUtils::assemble_data_uri (image_content_type, content, content_size).c_str(), &err);
+    DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (img), "src",
+        marked_icon_uri.c_str(), &err);
 
     g_object_unref (marked_icon_img);
   }
@@ -2014,17 +2464,17 @@ namespace Astroid {
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
 
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (e);
+      DomUtils::get_class_list (e);
 
     /* set class  */
     if (state[m].marked) {
-      webkit_dom_dom_token_list_add (class_list, "marked",
+      DomUtils::class_list_add (class_list, "marked",
           (err = NULL, &err));
     } else {
-      webkit_dom_dom_token_list_remove (class_list, "marked",
+      DomUtils::class_list_remove (class_list, "marked",
           (err = NULL, &err));
     }
 
@@ -2063,7 +2513,7 @@ namespace Astroid {
       WebKitDOMHTMLElement * mime_container =
         DomUtils::clone_select (WEBKIT_DOM_NODE(d), "#mime_template");
 
-      webkit_dom_element_remove_attribute (WEBKIT_DOM_ELEMENT (mime_container),
+      DomUtils::remove_attribute (WEBKIT_DOM_ELEMENT (mime_container),
           "id");
 
       // add attachment to message state
@@ -2071,7 +2521,7 @@ namespace Astroid {
       state[message].elements.push_back (e);
       log << debug << "tv: added mime message: " << state[message].elements.size() << endl;
 
-      webkit_dom_element_set_attribute (WEBKIT_DOM_ELEMENT (mime_container),
+      DomUtils::set_attribute (WEBKIT_DOM_ELEMENT (mime_container),
         "id", e.element_id().c_str(),
         (err = NULL, &err));
 
@@ -2083,13 +2533,13 @@ namespace Astroid {
       WebKitDOMHTMLElement * message_cont =
         DomUtils::select (WEBKIT_DOM_NODE (mime_container), ".message");
 
-      webkit_dom_html_element_set_inner_html (
+      DomUtils::set_inner_html (
           message_cont,
           content.c_str(),
           (err = NULL, &err));
 
 
-      webkit_dom_node_append_child (WEBKIT_DOM_NODE (span_body),
+      DomUtils::append_child (WEBKIT_DOM_NODE (span_body),
           WEBKIT_DOM_NODE (mime_container), (err = NULL, &err));
 
       g_object_unref (message_cont);
@@ -2578,11 +3028,11 @@ namespace Astroid {
 
           for (auto &m : toprint) {
             ustring mid = "message_" + m->mid;
-            WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+            WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
             WebKitDOMDOMTokenList * class_list =
-              webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(e));
+              DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(e));
 
-            webkit_dom_dom_token_list_add (class_list, "print",
+            DomUtils::class_list_add (class_list, "print",
                 (err = NULL, &err));
 
             /* expand */
@@ -2613,11 +3063,11 @@ namespace Astroid {
             }
 
             ustring mid = "message_" + m->mid;
-            WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+            WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
             WebKitDOMDOMTokenList * class_list =
-              webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(e));
+              DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(e));
 
-            webkit_dom_dom_token_list_remove (class_list, "print",
+            DomUtils::class_list_remove (class_list, "print",
                 (err = NULL, &err));
 
             g_object_unref (class_list);
@@ -2653,11 +3103,11 @@ namespace Astroid {
           WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
 
           ustring mid = "message_" + focused_message->mid;
-          WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+          WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
           WebKitDOMDOMTokenList * class_list =
-            webkit_dom_element_get_class_list (WEBKIT_DOM_ELEMENT(e));
+            DomUtils::get_class_list (WEBKIT_DOM_ELEMENT(e));
 
-          webkit_dom_dom_token_list_add (class_list, "print",
+          DomUtils::class_list_add (class_list, "print",
               (err = NULL, &err));
 
           /* expand */
@@ -2682,7 +3132,7 @@ namespace Astroid {
             toggle_hidden (focused_message, ToggleHide);
           }
 
-          webkit_dom_dom_token_list_remove (class_list, "print",
+          DomUtils::class_list_remove (class_list, "print",
               (err = NULL, &err));
 
           g_object_unref (class_list);
@@ -2818,12 +3268,16 @@ namespace Astroid {
           auto cp = Gtk::Clipboard::get (GDK_SELECTION_PRIMARY);
           ustring t;
 
-          auto d = focused_message->raw_contents ();
-          if (d->size () == 0) {
-            t = "";
+          auto src = focused_message->source;
+          if (src && src->in_memory ()) {
+            t = std::string (src->data (), src->size ());
           } else {
-            char * dd = (char*) d->get_data ();
-            t = dd;
+            auto d = focused_message->raw_contents ();
+            if (d->size () == 0) {
+              t = "";
+            } else {
+              t = std::string ((char*) d->get_data (), d->size ());
+            }
           }
 
           cp->set_text (t);
@@ -3021,7 +3475,7 @@ namespace Astroid {
     for (auto &m : mthread->messages) {
       ustring mid = "message_" + m->mid;
 
-      WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+      WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
       double clientY = webkit_dom_element_get_offset_top (e);
       double clientH = webkit_dom_element_get_client_height (e);
@@ -3079,7 +3533,7 @@ namespace Astroid {
     /* check if focused message is still visible */
     ustring mid = "message_" + focused_message->mid;
 
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     double clientY = webkit_dom_element_get_offset_top (e);
     double clientH = webkit_dom_element_get_client_height (e);
@@ -3113,7 +3567,7 @@ namespace Astroid {
       for (auto &m : mthread->messages) {
         ustring mid = "message_" + m->mid;
 
-        WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+        WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
         double clientY = webkit_dom_element_get_offset_top (e);
         double clientH = webkit_dom_element_get_client_height (e);
@@ -3122,7 +3576,7 @@ namespace Astroid {
         // log << debug << "h = " << clientH << endl;
 
         WebKitDOMDOMTokenList * class_list =
-          webkit_dom_element_get_class_list (e);
+          DomUtils::get_class_list (e);
 
         GError * gerr = NULL;
 
@@ -3140,12 +3594,12 @@ namespace Astroid {
           focused_message = m;
 
           /* set class  */
-          webkit_dom_dom_token_list_add (class_list, "focused",
+          DomUtils::class_list_add (class_list, "focused",
               (gerr = NULL, &gerr));
 
         } else {
           /* reset class */
-          webkit_dom_dom_token_list_remove (class_list, "focused",
+          DomUtils::class_list_remove (class_list, "focused",
               (gerr = NULL, &gerr));
         }
 
@@ -3167,10 +3621,10 @@ namespace Astroid {
     for (auto &m : mthread->messages) {
       ustring mid = "message_" + m->mid;
 
-      WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+      WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
       WebKitDOMDOMTokenList * class_list =
-        webkit_dom_element_get_class_list (e);
+        DomUtils::get_class_list (e);
 
       GError * gerr = NULL;
 
@@ -3178,7 +3632,7 @@ namespace Astroid {
       {
         if (!edit_mode) {
           /* set class  */
-          webkit_dom_dom_token_list_add (class_list, "focused",
+          DomUtils::class_list_add (class_list, "focused",
               (gerr = NULL, &gerr));
         }
 
@@ -3187,19 +3641,19 @@ namespace Astroid {
         for (auto el : state[m].elements) {
           if (eno > 0) {
 
-            WebKitDOMElement * ee = webkit_dom_document_get_element_by_id (d, el.element_id().c_str());
+            WebKitDOMElement * ee = DomUtils::get_element_by_id (d, el.element_id().c_str());
 
             WebKitDOMDOMTokenList * e_class_list =
-              webkit_dom_element_get_class_list (ee);
+              DomUtils::get_class_list (ee);
 
             if (eno == state[m].current_element) {
-              webkit_dom_dom_token_list_add (e_class_list, "focused",
+              DomUtils::class_list_add (e_class_list, "focused",
                   (gerr = NULL, &gerr));
 
             } else {
 
               /* reset class */
-              webkit_dom_dom_token_list_remove (e_class_list, "focused",
+              DomUtils::class_list_remove (e_class_list, "focused",
                   (gerr = NULL, &gerr));
 
             }
@@ -3214,7 +3668,7 @@ namespace Astroid {
       } else {
         /* reset class */
         if (!edit_mode) {
-          webkit_dom_dom_token_list_remove (class_list, "focused",
+          DomUtils::class_list_remove (class_list, "focused",
               (gerr = NULL, &gerr));
         }
 
@@ -3223,13 +3677,13 @@ namespace Astroid {
         for (auto el : state[m].elements) {
           if (eno > 0) {
 
-            WebKitDOMElement * ee = webkit_dom_document_get_element_by_id (d, el.element_id().c_str());
+            WebKitDOMElement * ee = DomUtils::get_element_by_id (d, el.element_id().c_str());
 
             WebKitDOMDOMTokenList * e_class_list =
-              webkit_dom_element_get_class_list (ee);
+              DomUtils::get_class_list (ee);
 
             /* reset class */
-            webkit_dom_dom_token_list_remove (e_class_list, "focused",
+            DomUtils::class_list_remove (e_class_list, "focused",
                 (gerr = NULL, &gerr));
 
             g_object_unref (e_class_list);
@@ -3272,7 +3726,7 @@ namespace Astroid {
         bool change_focus = force_change;
 
         if (!force_change) {
-          WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, eid.c_str());
+          WebKitDOMElement * e = DomUtils::get_element_by_id (d, eid.c_str());
 
           double scrolled = adj->get_value ();
           double height   = adj->get_page_size (); // 0 when there is
@@ -3352,7 +3806,7 @@ namespace Astroid {
 
             eid = next_e->element_id ();
 
-            WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, eid.c_str());
+            WebKitDOMElement * e = DomUtils::get_element_by_id (d, eid.c_str());
 
             double scrolled = adj->get_value ();
             double height   = adj->get_page_size (); // 0 when there is
@@ -3466,7 +3920,7 @@ namespace Astroid {
 
     ustring mid = "message_" + m->mid;
 
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     g_object_unref (e);
     g_object_unref (d);
@@ -3488,7 +3942,7 @@ namespace Astroid {
     }
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, eid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, eid.c_str());
 
     auto adj = scroll.get_vadjustment ();
     double scrolled = adj->get_value ();
@@ -3563,10 +4017,10 @@ namespace Astroid {
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
 
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (e);
+      DomUtils::get_class_list (e);
 
     GError * gerr = NULL;
 
@@ -3593,10 +4047,10 @@ namespace Astroid {
 
     WebKitDOMDocument * d = webkit_web_view_get_dom_document (webview);
 
-    WebKitDOMElement * e = webkit_dom_document_get_element_by_id (d, mid.c_str());
+    WebKitDOMElement * e = DomUtils::get_element_by_id (d, mid.c_str());
 
     WebKitDOMDOMTokenList * class_list =
-      webkit_dom_element_get_class_list (e);
+      DomUtils::get_class_list (e);
 
     GError * gerr = NULL;
 
@@ -3608,7 +4062,9 @@ namespace Astroid {
 
       /* reset class */
       if (t == ToggleToggle || t == ToggleShow) {
-        webkit_dom_dom_token_list_remove (class_list, "hide",
+        render_message_body (m);
+
+        DomUtils::class_list_remove (class_list, "hide",
             (gerr = NULL, &gerr));
       }
 
@@ -3617,7 +4073,7 @@ namespace Astroid {
 
       /* set class  */
       if (t == ToggleToggle || t == ToggleHide) {
-        webkit_dom_dom_token_list_add (class_list, "hide",
+        DomUtils::class_list_add (class_list, "hide",
             (gerr = NULL, &gerr));
       }
     }
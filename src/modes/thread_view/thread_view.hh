@@ -1,6 +1,7 @@
 # pragma once
 
 # include <atomic>
+# include <chrono>
 # include <map>
 # include <vector>
 # include <string>
@@ -12,6 +13,9 @@
 # include "modes/mode.hh"
 # include "message_thread.hh"
 # include "theme.hh"
+# include "web_view_pool.hh"
+# include "message_loader.hh"
+# include "thumbnail_loader.hh"
 # ifndef DISABLE_PLUGINS
   # include "plugin/manager.hh"
 # endif
@@ -59,6 +63,10 @@ namespace Astroid {
       const int INDENT_PX       = 20;
       bool      indent_messages;
 
+      /* build each message as one html string instead of filling in a
+       * cloned template element by element */
+      bool      batch_render;
+
       bool edit_mode = false;
       bool show_remote_images = false;
 
@@ -131,6 +139,11 @@ namespace Astroid {
           bool print_expanded   = false;
           bool marked           = false;
 
+          /* the body, mime messages and attachments have been
+           * inserted, collapsed messages are rendered when first
+           * expanded */
+          bool rendered         = false;
+
           enum ElementType {
             Empty,
             Address,
@@ -194,18 +207,49 @@ namespace Astroid {
       WebKitWebSettings * websettings;
 
     private:
+      WebViewPool::View * view;
+
       WebKitDOMHTMLDivElement * container = NULL;
 
       std::atomic<bool> wk_loaded;
+      void document_ready ();
 
       /* rendering */
       void render ();
       void render_messages ();
-      void add_message (refptr<Message>);
+
+      /* time and dom operations used to render the thread, logged when
+       * all messages have been rendered */
+      std::chrono::time_point<std::chrono::steady_clock> render_start;
+      unsigned long render_operations = 0;
+      void messages_rendered ();
+      void add_message (refptr<Message>, WebKitDOMNode * insert_before = NULL);
+
+      /* messages loaded by load_thread are parsed in the background and
+       * rendered as they become ready, in place of a placeholder. */
+      MessageLoader message_loader;
+      bool          streaming = false;
+      std::vector<MessageLoader::Stub>   message_stubs;
+      std::map<ustring, refptr<Message>> loaded_messages;
+      unsigned int  pending_messages = 0;
+
+      void show_message_thread (refptr<MessageThread>);
+      void on_message_loaded (ustring, refptr<Message>);
+      void insert_placeholders ();
+      void render_loaded_message (ustring mid);
+      void finish_loaded_messages ();
       void reload_images ();
 
       /* message loading */
       void set_message_html (refptr<Message>, WebKitDOMHTMLElement *);
+      ustring message_html (refptr<Message>, bool hide);
+      ustring header_html (refptr<Message>, ustring tags);
+      ustring tags_html (refptr<Message>);
+      ustring subject_html (refptr<Message>);
+      ustring preview_html (refptr<Message>);
+      ustring avatar_uri (refptr<Message>);
+      ustring message_warning (refptr<Message>);
+      void render_message_body (refptr<Message>);
       void create_message_part_html (refptr<Message>, refptr<Chunk>, WebKitDOMHTMLElement *, bool);
       void create_sibling_part (refptr<Message>, refptr<Chunk>, WebKitDOMHTMLElement *);
       void create_body_part (refptr<Message>, refptr<Chunk>, WebKitDOMHTMLElement *);
@@ -225,23 +269,35 @@ namespace Astroid {
 
       /* marked */
       refptr<Gdk::Pixbuf> marked_icon;
+      std::string         marked_icon_uri;
       void load_marked_icon (refptr<Message>, WebKitDOMHTMLElement *);
       void update_marked_state (refptr<Message>);
 
       /* attachments */
       bool insert_attachments (refptr<Message>, WebKitDOMHTMLElement *);
+      ustring attachments_html (refptr<Message>);
+      ustring attachment_src (refptr<Chunk>, ustring, ustring, bool &);
       void set_attachment_icon (refptr<Message>, WebKitDOMHTMLElement *);
 
       /* mime messages */
       void insert_mime_messages (refptr<Message>, WebKitDOMHTMLElement *);
 
       void set_attachment_src (refptr<Chunk>,
-          refptr<Glib::ByteArray>,
+          ustring,
+          ustring,
           WebKitDOMHTMLImageElement *);
 
       refptr<Gdk::Pixbuf> attachment_icon;
+      std::string         attachment_icon_uri;
 
       static const int THUMBNAIL_WIDTH = 150; // px
+
+      /* thumbnails of image attachments are made in the background */
+      ThumbnailLoader thumbnail_loader;
+      void on_thumbnail_ready (ustring, ustring, std::string);
+
+      /* cached thumbnails are requested relative to home_uri */
+      ustring thumbnail_uri (ustring key);
       static const int ATTACHMENT_ICON_WIDTH = 35;
 
       void save_all_attachments ();
@@ -287,7 +343,16 @@ namespace Astroid {
 
       /* changed signals */
       void on_message_changed (Db *, Message *, Message::MessageChangedEvent);
+
+      /* messages are shared through the message cache: the changed signals
+       * of the messages shown are disconnected when another thread is
+       * shown or the thread is rendered again. */
+      std::vector<sigc::connection> message_changed;
+      void connect_message_changed (refptr<Message>);
+      void disconnect_message_changed ();
+
       void on_thread_updated (Db *, ustring);
+      void on_refreshed_lastmod (Db *, unsigned long, unsigned long);
 
       /* search */
       bool search (Key);
@@ -0,0 +1,183 @@
+# include <algorithm>
+
+# include <gtkmm.h>
+# include <gmime/gmime.h>
+
+# include "astroid.hh"
+# include "log.hh"
+# include "chunk.hh"
+# include "dom_utils.hh"
+# include "thumbnail_cache.hh"
+# include "thumbnail_loader.hh"
+
+using std::endl;
+
+namespace Astroid {
+  ThumbnailLoader::ThumbnailLoader (int _width) : width (_width) {
+    run = false;
+
+    done_ready.connect (
+        sigc::mem_fun (this, &ThumbnailLoader::on_done_ready));
+  }
+
+  ThumbnailLoader::~ThumbnailLoader () {
+    clear ();
+
+    if (worker_thread.joinable ()) {
+      run = false;
+      jobs_cv.notify_all ();
+      worker_thread.join ();
+    }
+  }
+
+  void ThumbnailLoader::queue (refptr<Chunk> c, ustring element_id, ustring key) {
+    Job j;
+    j.element_id = element_id;
+    j.key        = key;
+    j.stream     = c->decoded_stream ();
+
+    std::unique_lock<std::mutex> lk (jobs_m);
+    jobs.push (j);
+
+    if (!worker_thread.joinable ()) {
+      run = true;
+      worker_thread = std::thread (&ThumbnailLoader::worker, this);
+    }
+
+    lk.unlock ();
+    jobs_cv.notify_one ();
+  }
+
+  void ThumbnailLoader::clear () {
+    std::unique_lock<std::mutex> lk (jobs_m);
+    while (!jobs.empty ()) {
+      g_object_unref (jobs.front ().stream);
+      jobs.pop ();
+    }
+
+    /* thumbnails being made or waiting to be handed over are dropped */
+    generation++;
+    lk.unlock ();
+
+    std::lock_guard<std::mutex> dlk (done_m);
+    while (!done.empty ()) done.pop ();
+  }
+
+  void ThumbnailLoader::worker () {
+    while (true) {
+      std::unique_lock<std::mutex> lk (jobs_m);
+      jobs_cv.wait (lk, [&] { return !run || !jobs.empty (); });
+
+      if (!run) break;
+
+      Job j = jobs.front ();
+      jobs.pop ();
+      unsigned int gen = generation;
+      lk.unlock ();
+
+      std::string png = make_thumbnail (j.stream);
+      g_object_unref (j.stream);
+
+      if (png.empty ()) continue;
+
+      Done d;
+      d.element_id = j.element_id;
+      d.key        = j.key;
+
+      if (!astroid->thumbnail_cache->put (j.key, png)) {
+        gchar * content = const_cast<gchar *> (png.data ());
+        d.data_uri = DomUtils::assemble_data_uri ("image/png", content, png.size ());
+      }
+
+      lk.lock ();
+      bool current = (gen == generation);
+      lk.unlock ();
+
+      if (current) {
+        std::unique_lock<std::mutex> dlk (done_m);
+        done.push (d);
+        dlk.unlock ();
+
+        done_ready.emit ();
+      }
+    }
+  }
+
+  std::string ThumbnailLoader::make_thumbnail (GMimeStream * stream) {
+    /* feed the decoded image to the loader in blocks, scaling it to the
+     * thumbnail width as soon as the size is known */
+    auto loader = Gdk::PixbufLoader::create ();
+
+    loader->signal_size_prepared ().connect (
+        [&] (int w, int h) {
+          if (w > 0) {
+            loader->set_size (width, std::max (1, h * width / w));
+          }
+        });
+
+    bool closed = false;
+
+    try {
+      char buf[16384];
+
+      while (!g_mime_stream_eos (stream)) {
+        if (!run) {
+          closed = true;
+          loader->close ();
+          return std::string ();
+        }
+
+        ssize_t n = g_mime_stream_read (stream, buf, sizeof (buf));
+        if (n <= 0) break;
+
+        loader->write (reinterpret_cast<const guint8 *> (buf), n);
+      }
+
+      closed = true;
+      loader->close ();
+
+      auto pb = loader->get_pixbuf ();
+      if (!pb) return std::string ();
+
+      pb = pb->apply_embedded_orientation ();
+
+      gchar * content;
+      gsize   content_size;
+      pb->save_to_buffer (content, content_size, "png");
+
+      std::string png (content, content_size);
+      g_free (content);
+
+      return png;
+
+    } catch (Glib::Error &ex) {
+      log << error << "tl: could not create thumbnail: " << ex.what () << endl;
+
+      if (!closed) {
+        try {
+          loader->close ();
+        } catch (Glib::Error &) { }
+      }
+
+      return std::string ();
+    }
+  }
+
+  void ThumbnailLoader::on_done_ready () {
+    std::unique_lock<std::mutex> lk (done_m);
+
+    while (!done.empty ()) {
+      Done d = done.front ();
+      done.pop ();
+
+      lk.unlock ();
+      m_signal_thumbnail_ready.emit (d.element_id, d.key, d.data_uri);
+      lk.lock ();
+    }
+  }
+
+  ThumbnailLoader::type_signal_thumbnail_ready ThumbnailLoader::signal_thumbnail_ready () {
+    return m_signal_thumbnail_ready;
+  }
+}
+
@@ -0,0 +1,72 @@
+# pragma once
+
+# include <atomic>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <queue>
+# include <string>
+
+# include <gtkmm.h>
+# include <gmime/gmime.h>
+
+# include "proto.hh"
+
+namespace Astroid {
+  /* creates thumbnails of image attachments on a background thread: the
+   * image is decoded incrementally and scaled while it is read, the full
+   * image is never kept in memory. the thumbnails are stored in the
+   * thumbnail cache and handed over on the gui thread. */
+  class ThumbnailLoader : public sigc::trackable {
+    public:
+      ThumbnailLoader (int width);
+      ~ThumbnailLoader ();
+
+      /* queue a thumbnail of the chunk for the attachment element with
+       * the given id, key is the thumbnail cache key */
+      void queue (refptr<Chunk>, ustring element_id, ustring key);
+
+      /* drop the queued thumbnails */
+      void clear ();
+
+      /* emitted on the gui thread with the element id and cache key, and
+       * the thumbnail as a data uri if it could not be cached. */
+      typedef sigc::signal <void, ustring, ustring, std::string> type_signal_thumbnail_ready;
+      type_signal_thumbnail_ready signal_thumbnail_ready ();
+
+    private:
+      int width;
+
+      struct Job {
+        ustring       element_id;
+        ustring       key;
+        GMimeStream * stream;
+      };
+
+      std::atomic<bool>       run;
+      std::thread             worker_thread;
+      std::mutex              jobs_m;
+      std::condition_variable jobs_cv;
+      std::queue<Job>         jobs;
+      unsigned int            generation = 0;
+
+      void worker ();
+      /* returns the png data of the thumbnail, empty on failure */
+      std::string make_thumbnail (GMimeStream *);
+
+      std::mutex done_m;
+      struct Done {
+        ustring     element_id;
+        ustring     key;
+        std::string data_uri;
+      };
+
+      std::queue<Done> done;
+
+      Glib::Dispatcher done_ready;
+      void on_done_ready ();
+
+      type_signal_thumbnail_ready m_signal_thumbnail_ready;
+  };
+}
+
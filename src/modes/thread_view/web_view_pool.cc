@@ -0,0 +1,169 @@
+# include <gtkmm.h>
+# include <webkit/webkit.h>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "log.hh"
+# include "theme.hh"
+# include "web_view_pool.hh"
+# include "utils/ustring_utils.hh"
+
+using std::endl;
+
+namespace Astroid {
+  WebViewPool::WebViewPool (unsigned int _size) : size (_size) {
+  }
+
+  WebViewPool::~WebViewPool () {
+    warm_idle.disconnect ();
+
+    for (View * v : views) {
+      g_object_unref (v->webview);
+      delete v;
+    }
+
+    views.clear ();
+
+    if (websettings != NULL) g_object_unref (websettings);
+  }
+
+  WebViewPool::View * WebViewPool::create () {
+    if (websettings == NULL) {
+      /* shared by all web views */
+      websettings = WEBKIT_WEB_SETTINGS (webkit_web_settings_new ());
+      g_object_set (G_OBJECT(websettings),
+          "enable-scripts", TRUE,
+          "enable-java-applet", FALSE,
+          "enable-plugins", FALSE,
+          "auto-load-images", TRUE,
+          "enable-display-of-insecure-content", FALSE,
+          "enable-dns-prefetching", FALSE,
+          "enable-fullscreen", FALSE,
+          "enable-html5-database", FALSE,
+          "enable-html5-local-storage", FALSE,
+       /* "enable-mediastream", FALSE, */
+          "enable-mediasource", FALSE,
+          "enable-offline-web-application-cache", FALSE,
+          "enable-page-cache", FALSE,
+          "enable-private-browsing", TRUE,
+          "enable-running-of-insecure-content", FALSE,
+          "enable-display-of-insecure-content", FALSE,
+          "enable-xss-auditor", TRUE,
+          "media-playback-requires-user-gesture", TRUE,
+          "enable-developer-extras", TRUE, // TODO: should only enabled conditionally
+
+          NULL);
+    }
+
+    Theme theme; // loads the theme once
+
+    View * v = new View ();
+
+    v->webview = WEBKIT_WEB_VIEW (webkit_web_view_new ());
+    g_object_ref_sink (v->webview);
+
+    webkit_web_view_set_settings (v->webview, websettings);
+
+    /* home uri used for thread view - request will be relative this
+     * non-existant (hopefully) directory. */
+    v->home_uri = ustring::compose ("%1/%2",
+        astroid->standard_paths ().config_dir.c_str(),
+        UstringUtils::random_alphanumeric (120));
+
+    /* connected before any thread view, so the document is styled before
+     * the thread view is notified */
+    g_signal_connect (v->webview, "notify::load-status",
+        G_CALLBACK(WebViewPool_on_load_changed),
+        (gpointer) v);
+
+    webkit_web_view_load_html_string (v->webview, theme.thread_view_html.c_str (), v->home_uri.c_str());
+
+    return v;
+  }
+
+  extern "C" bool WebViewPool_on_load_changed (
+      GtkWidget *       /* w */,
+      GParamSpec *      /* p */,
+      gpointer          data )
+  {
+    return WebViewPool::on_load_changed ((WebViewPool::View *) data);
+  }
+
+  bool WebViewPool::on_load_changed (View * v) {
+    if (v->loaded) return true;
+
+    WebKitLoadStatus ev = webkit_web_view_get_load_status (v->webview);
+
+    if (ev == WEBKIT_LOAD_FINISHED) {
+      log << debug << "wp: web view loaded." << endl;
+
+      Theme theme;
+
+      /* load css style */
+      GError *err = NULL;
+      WebKitDOMDocument *d = webkit_web_view_get_dom_document (v->webview);
+      WebKitDOMElement  *e = webkit_dom_document_create_element (d, theme.STYLE_NAME, &err);
+
+      WebKitDOMText *t = webkit_dom_document_create_text_node
+        (d, theme.thread_view_css.c_str());
+
+      webkit_dom_node_append_child (WEBKIT_DOM_NODE(e), WEBKIT_DOM_NODE(t), (err = NULL, &err));
+
+      WebKitDOMHTMLHeadElement * head = webkit_dom_document_get_head (d);
+      webkit_dom_node_append_child (WEBKIT_DOM_NODE(head), WEBKIT_DOM_NODE(e), (err = NULL, &err));
+
+      g_object_unref (d);
+      g_object_unref (e);
+      g_object_unref (t);
+      g_object_unref (head);
+
+      v->loaded = true;
+    }
+
+    return true;
+  }
+
+  WebViewPool::View * WebViewPool::get () {
+    View * v;
+
+    if (!views.empty ()) {
+      v = views.front ();
+      views.erase (views.begin ());
+
+      log << debug << "wp: using pooled web view (loaded: " << v->loaded << ")" << endl;
+    } else {
+      log << debug << "wp: no pooled web view, creating." << endl;
+      v = create ();
+    }
+
+    warm ();
+
+    return v;
+  }
+
+  void WebViewPool::release (View * v) {
+    g_signal_handlers_disconnect_by_data (v->webview, v);
+    g_object_unref (v->webview);
+    delete v;
+
+    warm ();
+  }
+
+  void WebViewPool::warm () {
+    if (views.size () >= size || warm_idle.connected ()) return;
+
+    warm_idle = Glib::signal_idle ().connect (
+        sigc::mem_fun (this, &WebViewPool::on_warm_idle),
+        Glib::PRIORITY_LOW);
+  }
+
+  bool WebViewPool::on_warm_idle () {
+    /* one web view at the time, the gui stays responsive */
+    if (views.size () < size) {
+      views.push_back (create ());
+    }
+
+    return (views.size () < size);
+  }
+}
+
@@ -0,0 +1,68 @@
+# pragma once
+
+# include <vector>
+
+# include <gtkmm.h>
+# include <webkit/webkit.h>
+
+# include "proto.hh"
+
+namespace Astroid {
+  extern "C" bool WebViewPool_on_load_changed (
+      GtkWidget *,
+      GParamSpec *,
+      gpointer );
+
+  /* pool of web views with the thread view document already loaded
+   *
+   * the web views are created and the theme (html and css) is loaded at
+   * idle time, so that a new thread view gets a web view that is ready.
+   * a thread view keeps its web view and document for every thread it
+   * shows, only the message container is cleared. web views released by
+   * a thread view are destroyed (other code may have connected to them),
+   * the pool is filled up again at idle time.
+   */
+  class WebViewPool : public sigc::trackable {
+    public:
+      /* size is the number of web views kept ready, 0 disables warm-up */
+      WebViewPool (unsigned int size);
+      ~WebViewPool ();
+
+      struct View {
+        WebKitWebView * webview = NULL;
+
+        /* relative url for requests */
+        ustring home_uri;
+
+        /* the document is loaded and styled */
+        bool loaded = false;
+
+        /* scripts added to the document */
+        bool mathjax       = false;
+        bool code_prettify = false;
+      };
+
+      /* returns a ready web view if there is one, otherwise a new one
+       * that is still loading. the view is owned by the caller until it
+       * is released. */
+      View * get ();
+      void   release (View *);
+
+      /* fill up the pool at idle time */
+      void warm ();
+
+      static bool on_load_changed (View *);
+
+    private:
+      unsigned int size;
+      std::vector<View *> views;
+
+      WebKitWebSettings * websettings = NULL;
+
+      View * create ();
+
+      sigc::connection warm_idle;
+      bool on_warm_idle ();
+  };
+}
+
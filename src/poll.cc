@@ -205,6 +205,10 @@ namespace Astroid {
       if (last_good_before_poll_revision == 0)
         last_good_before_poll_revision = before_poll_revision;
 
+      /* the poll script has modified the database without holding the
+       * read-write lock, pooled read-only handles are out of date. */
+      Db::invalidate_ro_pool ();
+
       /* update all threads that have been changed */
       Db db (Db::DbMode::DATABASE_READ_ONLY);
 
@@ -229,34 +233,18 @@ namespace Astroid {
 
         log << info << "poll: " << total_threads << " threads changed, updating.." << endl;
 
-        if (st == NOTMUCH_STATUS_SUCCESS && total_threads > 0) {
-          notmuch_threads_t * threads;
-          notmuch_thread_t  * thread;
-# ifdef HAVE_QUERY_THREADS_ST
-          st = notmuch_query_search_threads_st (qry, &threads);
-# else
-          threads = notmuch_query_search_threads (qry);
-# endif
-
-          for (;
-               (st == NOTMUCH_STATUS_SUCCESS) && notmuch_threads_valid (threads);
-               notmuch_threads_move_to_next (threads)) {
-
-            thread = notmuch_threads_get (threads);
-
-            const char * t = notmuch_thread_get_thread_id (thread);
+        notmuch_query_destroy (qry);
 
-            ustring tt (t);
-            astroid->actions->emit_thread_updated (&db, tt);
-          }
+        /* listeners update the threads modified in the revision range */
+        if (st == NOTMUCH_STATUS_SUCCESS && total_threads > 0) {
+          astroid->actions->emit_refreshed_lastmod (&db, before_poll_revision, revnow);
         }
 
-        notmuch_query_destroy (qry);
-
       }
 
       last_good_before_poll_revision = revnow;
 # else
+      Db::invalidate_ro_pool ();
       astroid->actions->signal_refreshed_dispatcher ();
 # endif
     }
@@ -22,11 +22,15 @@ namespace Astroid {
   //class Contacts;
   class Log;
   class Poll;
+  class ThreadCache;
+  class ThumbnailCache;
+  class MessageCache;
   class PluginManager;
 
   /* message and thread */
   class Message;
   class MessageThread;
+  class MessageSource;
   class Chunk;
 
   /* composing */
@@ -54,6 +58,7 @@ namespace Astroid {
   class ThreadIndexListCellRenderer;
   class ThreadIndexListView;
   class ThreadView;
+  class WebViewPool;
   class HelpMode;
   class EditMessage;
   class ReplyMessage;
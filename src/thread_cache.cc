@@ -0,0 +1,485 @@
+# include <iostream>
+# include <fstream>
+# include <vector>
+# include <cstring>
+# include <boost/filesystem.hpp>
+
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "thread_cache.hh"
+# include "db.hh"
+# include "config.hh"
+# include "log.hh"
+# include "actions/action_manager.hh"
+
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace Astroid {
+  const char ThreadCache::magic[8] = { 'A', 'S', 'T', 'T', 'H', 'R', 'C', '\0' };
+
+  /* separates authors and tags in the string table */
+  static const char field_sep = '\x1f';
+
+  ThreadCache::ThreadCache () :
+    ThreadCache (astroid->config ("thread_index").get<bool> ("summary_cache"))
+  {
+  }
+
+  ThreadCache::ThreadCache (bool enable) {
+    enabled = enable;
+
+# ifndef HAVE_NOTMUCH_GET_REV
+    if (enabled) {
+      log << warn << "tc: notmuch does not support lastmod, thread summary cache disabled." << endl;
+    }
+    enabled = false;
+# endif
+
+    if (!enabled) return;
+
+    cache_file = astroid->standard_paths ().cache_dir / bfs::path ("thread-summaries");
+
+    open ();
+
+    astroid->actions->signal_threads_changed ().connect (
+        sigc::mem_fun (this, &ThreadCache::on_threads_changed));
+
+    astroid->actions->signal_refreshed_lastmod ().connect (
+        sigc::mem_fun (this, &ThreadCache::on_refreshed_lastmod));
+  }
+
+  ThreadCache::~ThreadCache () {
+    save ();
+    close ();
+  }
+
+  string ThreadCache::query_key (ustring query, notmuch_sort_t sort,
+                                 vector<ustring> excluded_tags)
+  {
+    string k = ustring::compose ("%1", (int) sort);
+
+    for (auto &t : excluded_tags) {
+      k += field_sep;
+      k += t.raw ();
+    }
+
+    k += field_sep;
+    k += field_sep;
+    k += query.raw ();
+
+    return k;
+  }
+
+  void ThreadCache::open () {
+    /* map the cache file read-only, an invalid or missing file results
+     * in an empty cache. */
+    close ();
+
+    if (!bfs::exists (cache_file)) {
+      log << debug << "tc: no cache file: " << cache_file.c_str () << endl;
+      return;
+    }
+
+    fd = ::open (cache_file.c_str (), O_RDONLY);
+    if (fd < 0) {
+      log << error << "tc: could not open cache file: " << cache_file.c_str () << endl;
+      return;
+    }
+
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (Header)) {
+      log << warn << "tc: cache file is invalid, ignoring." << endl;
+      close ();
+      return;
+    }
+
+    map_size = st.st_size;
+    void * p = mmap (NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (p == MAP_FAILED) {
+      log << error << "tc: could not map cache file." << endl;
+      map = NULL;
+      close ();
+      return;
+    }
+
+    map = (char *) p;
+
+    const Header * h = (const Header *) map;
+
+    if (memcmp (h->magic, magic, sizeof (magic)) != 0 ||
+        h->version != version ||
+        h->strings > map_size ||
+        sizeof (Header) + (uint64_t) h->count * sizeof (Record) > h->strings)
+    {
+      log << warn << "tc: cache file has wrong format or version, ignoring." << endl;
+      close ();
+      return;
+    }
+
+    strings  = map + h->strings;
+    uuid     = string (h->uuid, strnlen (h->uuid, sizeof (h->uuid)));
+    revision = h->revision;
+
+    size_t strings_size = map_size - h->strings;
+
+    const Record * records = (const Record *) (map + sizeof (Header));
+    for (uint32_t i = 0; i < h->count; i++) {
+      const Record * r = &records[i];
+
+      if ((uint64_t) r->query + r->query_len > strings_size ||
+          (uint64_t) r->thread_id + r->thread_id_len > strings_size ||
+          (uint64_t) r->subject + r->subject_len > strings_size ||
+          (uint64_t) r->authors + r->authors_len > strings_size ||
+          (uint64_t) r->tags + r->tags_len > strings_size)
+      {
+        log << warn << "tc: cache file is corrupt, ignoring." << endl;
+        close ();
+        return;
+      }
+
+      mapped[string (strings + r->thread_id, r->thread_id_len)]
+            [string (strings + r->query, r->query_len)] = r;
+    }
+
+    log << info << "tc: loaded " << h->count << " thread summaries at revision: " << revision << endl;
+  }
+
+  void ThreadCache::close () {
+    mapped.clear ();
+    strings = NULL;
+
+    if (map != NULL) {
+      munmap (map, map_size);
+      map = NULL;
+      map_size = 0;
+    }
+
+    if (fd >= 0) {
+      ::close (fd);
+      fd = -1;
+    }
+  }
+
+  void ThreadCache::clear () {
+    mapped.clear ();
+    added.clear ();
+    dirty = true;
+  }
+
+  void ThreadCache::validate (Db * db) {
+# ifdef HAVE_NOTMUCH_GET_REV
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    string        db_uuid = db->get_uuid ();
+    unsigned long db_rev  = db->get_revision ();
+
+    if (db_uuid != uuid || db_rev < revision) {
+      if (!uuid.empty ()) {
+        log << info << "tc: database changed, dropping thread summaries." << endl;
+      }
+
+      clear ();
+      uuid     = db_uuid;
+      revision = db_rev;
+      return;
+    }
+
+    if (db_rev == revision) return;
+
+    /* invalidate threads with messages changed since the last validation */
+    ustring lastmod = ustring::compose ("lastmod:%1..%2", revision + 1, db_rev);
+
+    notmuch_query_t * query = notmuch_query_create (db->nm_db, lastmod.c_str ());
+    notmuch_messages_t * messages;
+    notmuch_status_t st = NOTMUCH_STATUS_SUCCESS;
+
+# ifdef HAVE_QUERY_THREADS_ST
+    st = notmuch_query_search_messages_st (query, &messages);
+# else
+    messages = notmuch_query_search_messages (query);
+# endif
+
+    if ((st != NOTMUCH_STATUS_SUCCESS) || messages == NULL) {
+      log << error << "tc: could not search changed messages, dropping thread summaries." << endl;
+      notmuch_query_destroy (query);
+
+      clear ();
+      revision = db_rev;
+      return;
+    }
+
+    for (; notmuch_messages_valid (messages);
+           notmuch_messages_move_to_next (messages)) {
+
+      notmuch_message_t * message = notmuch_messages_get (messages);
+      const char * tid = notmuch_message_get_thread_id (message);
+
+      if (tid != NULL) {
+        mapped.erase (tid);
+        added.erase (tid);
+      }
+
+      notmuch_message_destroy (message);
+    }
+
+    notmuch_messages_destroy (messages);
+    notmuch_query_destroy (query);
+
+    revision = db_rev;
+    dirty    = true;
+# endif
+  }
+
+  bool ThreadCache::decode (const Record * r, Summary & s) {
+    s.newest_date    = r->newest_date;
+    s.oldest_date    = r->oldest_date;
+    s.total_messages = r->total_messages;
+    s.flags          = r->flags;
+    s.subject        = string (strings + r->subject, r->subject_len);
+
+    /* authors: '1' or '0' (unread) followed by name, separated */
+    const char * a   = strings + r->authors;
+    const char * end = a + r->authors_len;
+    while (a < end) {
+      const char * e = (const char *) memchr (a, field_sep, end - a);
+      if (e == NULL) e = end;
+
+      if (e - a < 1) return false;
+
+      s.authors.push_back (std::make_tuple (ustring (string (a + 1, e - a - 1)), *a == '1'));
+
+      a = e + 1;
+    }
+
+    const char * t = strings + r->tags;
+    end = t + r->tags_len;
+    while (t < end) {
+      const char * e = (const char *) memchr (t, field_sep, end - t);
+      if (e == NULL) e = end;
+
+      s.tags.push_back (ustring (string (t, e - t)));
+
+      t = e + 1;
+    }
+
+    return true;
+  }
+
+  refptr<NotmuchThread> ThreadCache::get (
+      const string & query_key,
+      ustring thread_id,
+      bool details)
+  {
+    if (!enabled) return refptr<NotmuchThread> ();
+
+    std::lock_guard<std::mutex> lk (m);
+
+    Summary s;
+    bool found = false;
+
+    auto fnd = added.find (thread_id);
+    if (fnd != added.end ()) {
+      auto qfnd = fnd->second.find (query_key);
+      if (qfnd != fnd->second.end ()) {
+        s = qfnd->second;
+        found = true;
+      }
+    }
+
+    if (!found) {
+      auto mfnd = mapped.find (thread_id);
+      if (mfnd != mapped.end ()) {
+        auto qfnd = mfnd->second.find (query_key);
+        if (qfnd != mfnd->second.end ()) {
+          found = decode (qfnd->second, s);
+        }
+      }
+    }
+
+    if (!found) {
+      misses++;
+      return refptr<NotmuchThread> ();
+    }
+
+    hits++;
+
+    refptr<NotmuchThread> t = refptr<NotmuchThread> (new NotmuchThread (thread_id));
+
+    t->newest_date    = s.newest_date;
+    t->oldest_date    = s.oldest_date;
+    t->total_messages = s.total_messages;
+    t->unread         = (s.flags & FlagUnread);
+    t->attachment     = (s.flags & FlagAttachment);
+    t->flagged        = (s.flags & FlagFlagged);
+    t->tags           = s.tags;
+
+    if (details) {
+      t->subject        = s.subject;
+      t->authors        = s.authors;
+      t->details_loaded = true;
+    }
+
+    return t;
+  }
+
+  void ThreadCache::put (const string & query_key, refptr<NotmuchThread> t) {
+    if (!enabled || !t->details_loaded) return;
+
+    Summary s;
+    s.newest_date    = t->newest_date;
+    s.oldest_date    = t->oldest_date;
+    s.total_messages = t->total_messages;
+    s.flags          = (t->unread ? FlagUnread : 0) |
+                       (t->attachment ? FlagAttachment : 0) |
+                       (t->flagged ? FlagFlagged : 0);
+    s.subject        = t->subject;
+    s.authors        = t->authors;
+    s.tags           = t->tags;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    auto mfnd = mapped.find (t->thread_id);
+    if (mfnd != mapped.end ()) mfnd->second.erase (query_key);
+
+    added[t->thread_id][query_key] = s;
+    dirty = true;
+  }
+
+  void ThreadCache::invalidate (ustring thread_id) {
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    if (mapped.erase (thread_id) + added.erase (thread_id)) dirty = true;
+  }
+
+  void ThreadCache::save () {
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lk (m);
+
+    if (!dirty || uuid.empty ()) return;
+
+    vector<Record> records;
+    string         str;
+
+    auto append = [&] (const string & v, uint32_t & off, uint32_t & len) {
+      off = str.size ();
+      len = v.size ();
+      str += v;
+    };
+
+    /* threads in the mapped file are copied as they are */
+    for (auto &mp : mapped) {
+      for (auto &qp : mp.second) {
+        const Record * r = qp.second;
+        Record n = *r;
+
+        append (qp.first, n.query, n.query_len);
+        append (mp.first, n.thread_id, n.thread_id_len);
+        append (string (strings + r->subject, r->subject_len), n.subject, n.subject_len);
+        append (string (strings + r->authors, r->authors_len), n.authors, n.authors_len);
+        append (string (strings + r->tags, r->tags_len), n.tags, n.tags_len);
+
+        records.push_back (n);
+      }
+    }
+
+    for (auto &ap : added) {
+      for (auto &qp : ap.second) {
+        const Summary & s = qp.second;
+        Record n;
+
+        n.newest_date    = s.newest_date;
+        n.oldest_date    = s.oldest_date;
+        n.total_messages = s.total_messages;
+        n.flags          = s.flags;
+
+        string authors;
+        for (auto &a : s.authors) {
+          if (!authors.empty ()) authors += field_sep;
+          authors += (std::get<1> (a) ? '1' : '0');
+          authors += std::get<0> (a);
+        }
+
+        string tags;
+        for (auto &t : s.tags) {
+          if (!tags.empty ()) tags += field_sep;
+          tags += t;
+        }
+
+        append (qp.first, n.query, n.query_len);
+        append (ap.first, n.thread_id, n.thread_id_len);
+        append (s.subject, n.subject, n.subject_len);
+        append (authors, n.authors, n.authors_len);
+        append (tags, n.tags, n.tags_len);
+
+        records.push_back (n);
+      }
+    }
+
+    Header h;
+    memset (&h, 0, sizeof (h));
+    memcpy (h.magic, magic, sizeof (magic));
+    h.version  = version;
+    h.count    = records.size ();
+    h.revision = revision;
+    strncpy (h.uuid, uuid.c_str (), sizeof (h.uuid) - 1);
+    h.strings  = sizeof (Header) + records.size () * sizeof (Record);
+
+    /* write to a temporary file and move it in place, the current map
+     * stays valid until it is closed. */
+    bfs::path tmp = cache_file;
+    tmp += ".tmp";
+
+    if (!bfs::exists (cache_file.parent_path ())) {
+      bfs::create_directories (cache_file.parent_path ());
+    }
+
+    std::ofstream f (tmp.c_str (), std::ios::binary | std::ios::trunc);
+    f.write ((const char *) &h, sizeof (h));
+    if (!records.empty ())
+      f.write ((const char *) records.data (), records.size () * sizeof (Record));
+    f.write (str.data (), str.size ());
+    f.close ();
+
+    if (!f) {
+      log << error << "tc: could not write cache file: " << tmp.c_str () << endl;
+      bfs::remove (tmp);
+      return;
+    }
+
+    bfs::rename (tmp, cache_file);
+
+    log << info << "tc: saved " << records.size () << " thread summaries at revision: " << revision << endl;
+
+    /* the new file contains all summaries, map it again */
+    added.clear ();
+    open ();
+
+    dirty = false;
+  }
+
+  /***************
+   * signals
+   **************/
+  void ThreadCache::on_threads_changed (Db *, vector<ustring> thread_ids) {
+    for (auto &tid : thread_ids) invalidate (tid);
+  }
+
+  void ThreadCache::on_refreshed_lastmod (Db * db, unsigned long, unsigned long) {
+    validate (db);
+  }
+}
+
@@ -0,0 +1,144 @@
+# pragma once
+
+# include <mutex>
+# include <string>
+# include <vector>
+# include <tuple>
+# include <unordered_map>
+
+# include <stdint.h>
+
+# include <notmuch.h>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "proto.hh"
+
+namespace Astroid {
+  /* persistent cache of thread summaries (the fields of NotmuchThread)
+   *
+   * the dates, subject and author order of a thread depend on which of its
+   * messages match the query and on the sort order, so a summary belongs
+   * to a query key (see query_key ()) and a thread id. a thread changed in
+   * any way is invalidated for all queries.
+   *
+   * the summaries are stored in a memory mapped file in the cache dir. the
+   * cache belongs to a database (uuid) and is valid up to a revision,
+   * threads that have been modified since are invalidated using lastmod
+   * when the cache is validated. summaries that are added or updated after
+   * the file was mapped are kept in memory and written back by save ().
+   *
+   * requires notmuch with lastmod support (HAVE_NOTMUCH_GET_REV), otherwise
+   * the cache is never enabled.
+   */
+  class ThreadCache : public sigc::trackable {
+    public:
+      ThreadCache ();
+      ThreadCache (bool enable);
+      ~ThreadCache ();
+
+      bool enabled;
+
+      /* the key of the summaries loaded by a query */
+      static std::string query_key (ustring query, notmuch_sort_t sort,
+                                    std::vector<ustring> excluded_tags);
+
+      /* check database uuid and invalidate threads modified since the
+       * cache was last validated */
+      void validate (Db *);
+
+      /* returns a thread, or an empty refptr. the subject and authors are
+       * only set with `details`: threads in the thread index get their
+       * details through ThreadIndexListStore::touch, which limits how many
+       * are kept. */
+      refptr<NotmuchThread> get (const std::string & query_key,
+                                 ustring thread_id,
+                                 bool details = false);
+
+      /* store thread, only threads with details loaded are stored */
+      void put (const std::string & query_key, refptr<NotmuchThread>);
+
+      /* drop the thread for all queries */
+      void invalidate (ustring thread_id);
+
+      void save ();
+
+      unsigned long hits   = 0;
+      unsigned long misses = 0;
+
+    private:
+      std::mutex m;
+      bfs::path  cache_file;
+
+      static const char     magic[8];
+      static const uint32_t version = 2;
+
+      struct Header {
+        char      magic[8];
+        uint32_t  version;
+        uint32_t  count;
+        uint64_t  revision;
+        char      uuid[64];
+        uint64_t  strings;  // offset of string table
+      };
+
+      /* string offsets are relative to the string table */
+      struct Record {
+        uint32_t  query, query_len;
+        uint32_t  thread_id, thread_id_len;
+        int64_t   newest_date;
+        int64_t   oldest_date;
+        int32_t   total_messages;
+        uint32_t  flags;
+        uint32_t  subject, subject_len;
+        uint32_t  authors, authors_len;
+        uint32_t  tags, tags_len;
+      };
+
+      enum {
+        FlagUnread      = 1 << 0,
+        FlagAttachment  = 1 << 1,
+        FlagFlagged     = 1 << 2,
+      };
+
+      struct Summary {
+        time_t        newest_date;
+        time_t        oldest_date;
+        int           total_messages;
+        uint32_t      flags;
+        std::string   subject;
+        std::vector<std::tuple<ustring,bool>> authors;
+        std::vector<ustring> tags;
+      };
+
+      /* mapped file */
+      int     fd        = -1;
+      char *  map       = NULL;
+      size_t  map_size  = 0;
+      const char * strings = NULL;
+
+      void open ();
+      void close ();
+
+      bool          validated = false;
+      std::string   uuid;
+      unsigned long revision  = 0;
+
+      /* summaries in the mapped file and summaries added since, by thread
+       * id and query key */
+      std::unordered_map<std::string,
+        std::unordered_map<std::string, const Record *>> mapped;
+      std::unordered_map<std::string,
+        std::unordered_map<std::string, Summary>>        added;
+
+      bool dirty = false;
+
+      bool decode (const Record *, Summary &);
+      void clear ();
+
+      /* signals */
+      void on_refreshed_lastmod (Db *, unsigned long, unsigned long);
+      void on_threads_changed (Db *, std::vector<ustring>);
+  };
+}
+
@@ -0,0 +1,158 @@
+# include <vector>
+# include <fstream>
+# include <algorithm>
+# include <ctime>
+# include <thread>
+# include <functional>
+# include <boost/filesystem.hpp>
+
+# include <glibmm.h>
+
+# include "astroid.hh"
+# include "thumbnail_cache.hh"
+# include "log.hh"
+
+using std::endl;
+using std::vector;
+
+namespace Astroid {
+  ThumbnailCache::ThumbnailCache (bfs::path _dir, uintmax_t _max_size) :
+    dir (_dir),
+    max_size (_max_size)
+  {
+    enabled = (max_size > 0);
+
+    if (!enabled) return;
+
+    try {
+      if (!bfs::exists (dir)) bfs::create_directories (dir);
+
+      /* sum up the existing thumbnails */
+      for (bfs::directory_iterator it (dir); it != bfs::directory_iterator (); ++it) {
+        if (bfs::is_regular_file (it->status ())) {
+          current_size += bfs::file_size (it->path ());
+        }
+      }
+
+    } catch (bfs::filesystem_error &ex) {
+      log << error << "thc: could not open thumbnail cache: " << dir.c_str () << ": " << ex.what () << endl;
+      enabled = false;
+      return;
+    }
+
+    log << debug << "thc: thumbnail cache: " << dir.c_str () << ", size: " << current_size << " of " << max_size << endl;
+  }
+
+  ustring ThumbnailCache::make_key (ustring mid, int attachment, size_t size, int width) {
+    return Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_SHA1,
+        ustring::compose ("%1\n%2\n%3\n%4", mid, attachment, size, width));
+  }
+
+  bool ThumbnailCache::valid_key (ustring key) {
+    /* the key is used as a file name */
+    return !key.empty () && std::all_of (key.begin (), key.end (),
+        [] (gunichar c) { return g_ascii_isxdigit (c); });
+  }
+
+  bool ThumbnailCache::get (ustring key, bfs::path & p) {
+    if (!enabled || !valid_key (key)) return false;
+
+    p = dir / bfs::path (key + ".png");
+
+    boost::system::error_code ec;
+    if (!bfs::exists (p, ec)) return false;
+
+    /* mark as recently used */
+    bfs::last_write_time (p, time (NULL), ec);
+
+    return true;
+  }
+
+  bool ThumbnailCache::put (ustring key, const std::string & png) {
+    if (!enabled || !valid_key (key)) return false;
+
+    bfs::path p   = dir / bfs::path (key + ".png");
+    /* several thread views may write the same thumbnail */
+    bfs::path tmp = dir / bfs::path (ustring::compose ("%1.%2.tmp", key,
+          std::hash<std::thread::id> () (std::this_thread::get_id ())));
+
+    std::ofstream f (tmp.c_str (), std::ofstream::binary);
+    f.write (png.data (), png.size ());
+    f.close ();
+
+    boost::system::error_code ec;
+
+    if (f.fail ()) {
+      log << error << "thc: could not write thumbnail: " << tmp.c_str () << endl;
+      bfs::remove (tmp, ec);
+      return false;
+    }
+
+    bfs::rename (tmp, p, ec);
+    if (ec) {
+      log << error << "thc: could not write thumbnail: " << p.c_str () << endl;
+      bfs::remove (tmp, ec);
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lk (m);
+    current_size += png.size ();
+
+    if (current_size > max_size) evict ();
+
+    return true;
+  }
+
+  void ThumbnailCache::evict () {
+    /* remove the least recently used thumbnails until the cache is at
+     * three quarters of its maximum size, so that it is not scanned for
+     * every thumbnail that is added. */
+    struct Entry {
+      bfs::path p;
+      std::time_t t;
+      uintmax_t   sz;
+    };
+
+    vector<Entry> entries;
+    current_size = 0;
+
+    boost::system::error_code ec;
+
+    for (bfs::directory_iterator it (dir, ec); !ec && it != bfs::directory_iterator (); it.increment (ec)) {
+      if (!bfs::is_regular_file (it->path (), ec)) continue;
+
+      Entry e;
+      e.p  = it->path ();
+      e.t  = bfs::last_write_time (e.p, ec);
+      e.sz = bfs::file_size (e.p, ec);
+
+      if (ec) continue;
+
+      current_size += e.sz;
+      entries.push_back (e);
+    }
+
+    std::sort (entries.begin (), entries.end (),
+        [] (const Entry & a, const Entry & b) { return a.t < b.t; });
+
+    uintmax_t target = max_size / 4 * 3;
+    int removed = 0;
+
+    for (auto & e : entries) {
+      if (current_size <= target) break;
+
+      if (bfs::remove (e.p, ec)) {
+        current_size -= e.sz;
+        removed++;
+      }
+    }
+
+    log << debug << "thc: evicted " << removed << " thumbnails, size: " << current_size << endl;
+  }
+
+  uintmax_t ThumbnailCache::size () {
+    std::lock_guard<std::mutex> lk (m);
+    return current_size;
+  }
+}
+
@@ -0,0 +1,49 @@
+# pragma once
+
+# include <mutex>
+# include <string>
+
+# include <stdint.h>
+
+# include "astroid.hh"
+# include "config.hh"
+# include "proto.hh"
+
+namespace Astroid {
+  /* persistent cache of attachment thumbnails
+   *
+   * thumbnails are stored as png files in a directory of the cache dir,
+   * named by a key derived from the message and attachment. the least
+   * recently used thumbnails (by modification time) are removed when the
+   * cache grows beyond its maximum size.
+   */
+  class ThumbnailCache {
+    public:
+      /* max_size is in bytes, 0 disables the cache */
+      ThumbnailCache (bfs::path dir, uintmax_t max_size);
+
+      bool enabled;
+
+      static ustring make_key (ustring mid, int attachment, size_t size, int width);
+
+      /* returns true and sets the path of the thumbnail if it is cached,
+       * the thumbnail is marked as recently used. */
+      bool get (ustring key, bfs::path & p);
+
+      /* store a thumbnail, returns true if it was written */
+      bool put (ustring key, const std::string & png);
+
+      uintmax_t size ();
+
+    private:
+      std::mutex m;
+
+      bfs::path dir;
+      uintmax_t max_size;
+      uintmax_t current_size = 0;
+
+      bool valid_key (ustring);
+      void evict ();
+  };
+}
+
@@ -137,6 +137,64 @@ namespace Astroid {
     return v;
   }
 
+  time_t Date::next_change (time_t t) {
+    time_t now  = time (NULL);
+    time_t diff = now - t;
+
+    CoarseDate cd = coarse_date (t);
+
+    /* local midnight after now and the start of next year */
+    struct tm * temp_t = localtime (&now);
+    struct tm m = *temp_t;
+    m.tm_sec   = 0;
+    m.tm_min   = 0;
+    m.tm_hour  = 0;
+    m.tm_isdst = -1;
+
+    struct tm y = m;
+
+    m.tm_mday += 1;
+    time_t midnight = mktime (&m);
+
+    y.tm_mday = 1;
+    y.tm_mon  = 0;
+    y.tm_year += 1;
+    time_t new_year = mktime (&y);
+
+    if (clock_format == ClockFormat::YEAR) {
+      if (cd == CoarseDate::YEARS) return 0;
+      if (cd == CoarseDate::FUTURE && diff < 0) return t;
+      return new_year;
+    }
+
+    switch (cd) {
+      case CoarseDate::FUTURE:
+        if (diff < 0) return t;
+        return midnight;
+
+      case CoarseDate::NOW:
+        return std::min (t + 60, midnight);
+
+      case CoarseDate::MINUTES:
+        return std::min (t + 60 * (diff / 60 + 1), midnight);
+
+      case CoarseDate::HOURS:
+        return std::min (t + 60 * 60 * (diff / (60 * 60) + 1), midnight);
+
+      case CoarseDate::TODAY:
+      case CoarseDate::YESTERDAY:
+      case CoarseDate::THIS_WEEK:
+        return midnight;
+
+      case CoarseDate::THIS_YEAR:
+        return new_year;
+
+      case CoarseDate::YEARS:
+      default:
+        return 0;
+    }
+  }
+
   void Date::init () {
     log << info << "date: init." << endl;
 
@@ -46,6 +46,10 @@ namespace Astroid {
       static ustring pretty_print (time_t );
       static ustring pretty_print_verbose (time_t, bool = false);
 
+      /* the time when pretty_print (t) may next change, or 0 if it will
+       * not change */
+      static time_t next_change (time_t t);
+
       static void init ();
   };
 }
@@ -37,6 +37,7 @@ namespace Astroid {
       if (exists (user_p)) {
         log << info << "re: using user configured resource: " << absolute(local_p).c_str () << endl;
         finalpath = user_p;
+        user_configured = true;
         return;
       }
     }
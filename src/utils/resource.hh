@@ -14,6 +14,9 @@ namespace Astroid {
 
       path get_path ();
 
+      /* the resource is the one in the users config dir */
+      bool user_configured = false;
+
     private:
       path finalpath;
   };
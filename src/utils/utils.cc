@@ -17,6 +17,9 @@ namespace Astroid {
   Pango::Color Utils::tags_lower_color;
   float        Utils::tags_alpha;
 
+  std::mutex   Utils::tag_formats_m;
+  std::unordered_map<std::string, Utils::TagFormat> Utils::tag_formats;
+
   void Utils::init () {
     ptree ti = astroid->config ("thread_index.cell");
 
@@ -39,6 +42,9 @@ namespace Astroid {
     tags_alpha = ti.get<float> ("tags_alpha");
     if (tags_alpha > 1) tags_alpha = 1;
     if (tags_alpha < 0) tags_alpha = 0;
+
+    std::lock_guard<std::mutex> lk (tag_formats_m);
+    tag_formats.clear ();
   }
 
   ustring Utils::format_size (int sz) {
@@ -67,6 +73,57 @@ namespace Astroid {
   }
 
   std::pair<ustring, ustring> Utils::get_tag_color (ustring t, unsigned char cv[3]) {
+    TagFormat f = get_tag_format (t, cv);
+    return std::make_pair (f.fg, f.bg);
+  }
+
+  Utils::TagFormat Utils::get_tag_format (ustring t, unsigned char cv[3]) {
+    std::string key ((const char *) cv, 3);
+    key += t;
+
+    std::lock_guard<std::mutex> lk (tag_formats_m);
+
+    auto fnd = tag_formats.find (key);
+    if (fnd != tag_formats.end ()) return fnd->second;
+
+    auto colors = calculate_tag_color (t, cv);
+
+    TagFormat f;
+    f.fg = colors.first;
+    f.bg = colors.second;
+
+    f.pango = format_tag (t, f.fg, f.bg, true);
+    f.html  = format_tag (t, f.fg, f.bg, false);
+
+    tag_formats[key] = f;
+    return f;
+  }
+
+  ustring Utils::format_tag (ustring t, ustring fg, ustring bg, bool pango) {
+    if (pango) {
+      return ustring::compose (
+                  "<span bgcolor=\"%3\" color=\"%1\"> %2 </span>",
+                  fg,
+                  Glib::Markup::escape_text(t),
+                  bg );
+
+    } else {
+      Gdk::RGBA bgc (bg.substr (0, 7));
+      bgc.set_alpha (tags_alpha);
+
+      return ustring::compose (
+                  "<span style=\"background-color: rgba(%3, %4, %5, %6); color: %1 !important; white-space: pre;\"> %2 </span>",
+                  fg,
+                  Glib::Markup::escape_text(t),
+                  bgc.get_red () * 255 ,
+                  bgc.get_green () * 255 ,
+                  bgc.get_blue () * 255,
+                  bgc.get_alpha ()
+                  );
+    }
+  }
+
+  std::pair<ustring, ustring> Utils::calculate_tag_color (ustring t, unsigned char cv[3]) {
     unsigned char * tc = Crypto::get_md5_digest_char (t);
 
     unsigned char upper[3] = {
@@ -4,6 +4,10 @@
 
 # pragma once
 
+# include <mutex>
+# include <string>
+# include <unordered_map>
+
 namespace Astroid {
 
   class Utils {
@@ -23,6 +27,26 @@ namespace Astroid {
       static Pango::Color tags_upper_color;
       static Pango::Color tags_lower_color;
 
+      /* the colors and markup of a tag on a canvas color, computed once
+       * per tag and canvas color and kept until the next init (). returned
+       * by value since the cache may be cleared by another thread. */
+      struct TagFormat {
+        ustring fg;
+        ustring bg;
+        ustring pango;  // pango markup
+        ustring html;   // html markup
+      };
+
+      static TagFormat get_tag_format (ustring, unsigned char canvascolor[3]);
+
+      /* markup for a tag with the given colors */
+      static ustring format_tag (ustring, ustring fg, ustring bg, bool pango);
+
+    private:
+      static std::pair<ustring, ustring> calculate_tag_color (ustring, unsigned char canvascolor[3]);
+
+      static std::mutex tag_formats_m;
+      static std::unordered_map<std::string, TagFormat> tag_formats;
   };
 }
 
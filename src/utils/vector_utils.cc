@@ -81,7 +81,7 @@ namespace Astroid {
         }
       } else first = false;
 
-      auto colors = Utils::get_tag_color (t, canvascolor);
+      Utils::TagFormat f = Utils::get_tag_format (t, canvascolor);
 
       if (maxlen > 0) {
         broken = true;
@@ -91,32 +91,19 @@ namespace Astroid {
         if ((len + t.length () + 2) > static_cast<unsigned int>(maxlen)) {
           t = t.substr (0, (len + t.length () + 2 - maxlen));
           t += "..";
+
+          /* truncated tags are not memoized */
+          len += t.length () + 2;
+
+          tag_string += Utils::format_tag (t, f.fg, f.bg, pango);
+
+          continue;
         }
 
         len += t.length () + 2;
       }
 
-      if (pango) {
-        tag_string += ustring::compose (
-                    "<span bgcolor=\"%3\" color=\"%1\"> %2 </span>",
-                    colors.first,
-                    Glib::Markup::escape_text(t),
-                    colors.second );
-
-      } else {
-        Gdk::RGBA bg (colors.second.substr (0, 7));
-        bg.set_alpha (Utils::tags_alpha);
-
-        tag_string += ustring::compose (
-                    "<span style=\"background-color: rgba(%3, %4, %5, %6); color: %1 !important; white-space: pre;\"> %2 </span>",
-                    colors.first,
-                    Glib::Markup::escape_text(t),
-                    bg.get_red () * 255 ,
-                    bg.get_green () * 255 ,
-                    bg.get_blue () * 255,
-                    bg.get_alpha ()
-                    );
-      }
+      tag_string += (pango ? f.pango : f.html);
     }
 
     if (broken) {
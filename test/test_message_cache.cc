@@ -0,0 +1,128 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestMessageCache
+# include <boost/test/unit_test.hpp>
+# include <thread>
+
+# include "test_common.hh"
+# include "db.hh"
+# include "message_thread.hh"
+# include "message_cache.hh"
+
+using namespace Astroid;
+
+BOOST_AUTO_TEST_SUITE(MessageCacheTest)
+
+  BOOST_AUTO_TEST_CASE(load_and_evict)
+  {
+    setup ();
+
+    MessageCache mc (10 * 1024 * 1024);
+    BOOST_REQUIRE (mc.enabled);
+
+    ustring mid1 = "1255623468-sup-2284@yoom.home.cworth.org";
+    ustring mid2 = "1256009934-sup-9323@yoom.home.cworth.org";
+
+    refptr<Message> m1, m1b, m2;
+
+    Db db (Db::DATABASE_READ_ONLY);
+
+    db.on_message (mid1, [&](notmuch_message_t * msg) {
+        BOOST_REQUIRE (msg != NULL);
+        m1  = mc.load (msg, 0);
+        m1b = mc.load (msg, 1);
+      });
+
+    /* the second load is the same parsed message */
+    BOOST_CHECK (m1 == m1b);
+    BOOST_CHECK (m1->level == 1);
+    BOOST_CHECK (mc.hits == 1);
+    BOOST_CHECK (mc.misses == 1);
+    BOOST_CHECK (mc.count () == 1);
+
+    BOOST_CHECK (mc.get (mid1, m1->fname));
+    BOOST_CHECK (!mc.get (mid1, "test/mail/test_mail/no-such-file.eml"));
+
+    /* the mismatching file dropped the message */
+    BOOST_CHECK (mc.count () == 0);
+
+    mc.put (m1);
+    BOOST_CHECK (mc.count () == 1);
+
+    db.on_message (mid2, [&](notmuch_message_t * msg) {
+        BOOST_REQUIRE (msg != NULL);
+        m2 = mc.load (msg, 0);
+      });
+
+    BOOST_CHECK (mc.count () == 2);
+
+    mc.invalidate (mid1);
+    BOOST_CHECK (mc.count () == 1);
+    BOOST_CHECK (!mc.get (mid1, m1->fname));
+    BOOST_CHECK (mc.get (mid2, m2->fname));
+
+    mc.clear ();
+    BOOST_CHECK (mc.size () == 0);
+
+    /* too small for any message */
+    MessageCache small (1024);
+    small.put (m1);
+    BOOST_CHECK (small.count () == 0);
+
+    /* at most one message */
+    MessageCache one (10 * 1024 * 1024, 1);
+    one.put (m1);
+    one.put (m2);
+    BOOST_CHECK (one.count () == 1);
+    BOOST_CHECK (!one.get (mid1, m1->fname));
+    BOOST_CHECK (one.get (mid2, m2->fname));
+
+    db.close ();
+
+    teardown ();
+  }
+
+  BOOST_AUTO_TEST_CASE(take_over_parse)
+  {
+    setup ();
+
+    MessageCache mc (10 * 1024 * 1024);
+
+    ustring mid = "1255623468-sup-2284@yoom.home.cworth.org";
+    refptr<Message> m;
+
+    /* nothing is being parsed */
+    BOOST_CHECK (!mc.take_parse (mid, m));
+
+    BOOST_CHECK (mc.begin_parse (mid));
+    BOOST_CHECK (!mc.begin_parse (mid));
+
+    /* not taken over, the message is left to the parser */
+    BOOST_CHECK (!mc.end_parse (mid, m));
+    BOOST_CHECK (mc.begin_parse (mid));
+
+    /* a loader waits for the parser and takes the message */
+    refptr<Message> parsed = refptr<Message> (new Message ());
+    refptr<Message> taken;
+    bool took = false;
+
+    std::thread loader ([&] {
+        while (!(took = mc.take_parse (mid, taken))) std::this_thread::yield ();
+      });
+
+    /* parse again until the loader is waiting */
+    while (!mc.end_parse (mid, parsed)) {
+      BOOST_REQUIRE (mc.begin_parse (mid));
+      std::this_thread::yield ();
+    }
+
+    loader.join ();
+
+    BOOST_CHECK (took);
+    BOOST_CHECK (taken == parsed);
+    BOOST_CHECK (mc.begin_parse (mid));
+
+    teardown ();
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+
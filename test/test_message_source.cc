@@ -0,0 +1,104 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestMessageSource
+# include <boost/test/unit_test.hpp>
+# include <boost/filesystem.hpp>
+# include <fstream>
+# include <sstream>
+
+# include "test_common.hh"
+# include "config.hh"
+# include "message_thread.hh"
+# include "message_source.hh"
+
+using namespace Astroid;
+
+BOOST_AUTO_TEST_SUITE(MessageSourceTest)
+
+  BOOST_AUTO_TEST_CASE(read_source)
+  {
+    setup ();
+
+    ustring fname = "test/mail/test_mail/no-nl.eml";
+
+    std::ifstream f (fname);
+    std::stringstream s;
+    s << f.rdbuf ();
+    std::string raw = s.str ();
+
+    Message m (fname);
+
+    BOOST_REQUIRE (m.source);
+    BOOST_REQUIRE (m.source->in_memory ());
+    BOOST_CHECK (!m.source->mapped ());
+    BOOST_CHECK (m.source->size () == raw.size ());
+    BOOST_CHECK (std::string (m.source->data (), m.source->size ()) == raw);
+
+    /* the raw contents are the bytes of the file */
+    auto c = m.raw_contents ();
+    BOOST_CHECK (std::string ((const char *) c->get_data (), c->size ()) == raw);
+
+    /* the parsed message still reads from the source */
+    BOOST_CHECK (m.viewable_text (false).find ("line-ignored") != ustring::npos);
+
+    /* saving writes the file in memory */
+    bfs::path to = astroid->standard_paths ().cache_dir / bfs::path ("test-source.eml");
+    bfs::remove (to);
+
+    m.save_to (to.c_str ());
+
+    std::ifstream t (to.c_str ());
+    std::stringstream ts;
+    ts << t.rdbuf ();
+    BOOST_CHECK (ts.str () == raw);
+
+    bfs::remove (to);
+
+    teardown ();
+  }
+
+  BOOST_AUTO_TEST_CASE(mapped_source)
+  {
+    setup ();
+
+    /* a message large enough to be mapped */
+    bfs::path fname = astroid->standard_paths ().cache_dir / bfs::path ("test-large.eml");
+
+    std::string raw = "From: a@example.com\nTo: b@example.com\nSubject: large\n\n";
+    while (raw.size () < MessageSource::map_threshold + 1) {
+      raw += "a line of the body of a large message.\n";
+    }
+
+    {
+      std::ofstream f (fname.c_str (), std::ios::binary);
+      f << raw;
+    }
+
+    int fds = std::distance (bfs::directory_iterator ("/proc/self/fd"),
+                             bfs::directory_iterator ());
+
+    {
+      Message m (fname.c_str ());
+
+      BOOST_REQUIRE (m.source);
+      BOOST_REQUIRE (m.source->mapped ());
+      BOOST_REQUIRE (m.source->in_memory ());
+      BOOST_CHECK (m.source->size () == raw.size ());
+      BOOST_CHECK (std::string (m.source->data (), m.source->size ()) == raw);
+
+      /* the file is not kept open */
+      int now = std::distance (bfs::directory_iterator ("/proc/self/fd"),
+                               bfs::directory_iterator ());
+      BOOST_CHECK (now == fds);
+
+      /* a truncated file is no longer read through the mapping */
+      bfs::resize_file (fname, 10);
+      BOOST_CHECK (!m.source->in_memory ());
+    }
+
+    bfs::remove (fname);
+
+    teardown ();
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -48,8 +48,8 @@ BOOST_AUTO_TEST_SUITE(Reading)
     /* test if file can be read now */
     Message * mm;
     BOOST_CHECK_NO_THROW (mm = new Message ("test/mail/test_mail/oos.eml"));
-    BOOST_CHECK ((AddressList (mm->other_to ()).str () == "ba@adsf.asd"));
-    Astroid::log << test << "other: " << AddressList (mm->other_to ()).str () << endl;
+    BOOST_CHECK ((mm->other_to ().str () == "ba@adsf.asd"));
+    Astroid::log << test << "other: " << mm->other_to ().str () << endl;
     delete mm;
 
     /* remove it without updating notmuch */
@@ -78,10 +78,10 @@ BOOST_AUTO_TEST_SUITE(Reading)
     Astroid::log << test << "text: " << oos->viewable_text (false) << endl;
 
     /* these do not seem to be cached */
-    Astroid::log << test << "to: " << AddressList (oos->to()).str() << endl;
-    Astroid::log << test << "cc: " << AddressList (oos->cc()).str() << endl;
-    Astroid::log << test << "bcc: " << AddressList (oos->bcc()).str() << endl;
-    Astroid::log << test << "other: " << AddressList (oos->other_to ()).str () << endl;
+    Astroid::log << test << "to: " << oos->to ().str () << endl;
+    Astroid::log << test << "cc: " << oos->cc ().str () << endl;
+    Astroid::log << test << "bcc: " << oos->bcc ().str () << endl;
+    Astroid::log << test << "other: " << oos->other_to ().str () << endl;
     Astroid::log << test << "date: " << oos->date () << endl;
 
     Astroid::log << test << "pretty date: " << oos->pretty_verbose_date() << endl;
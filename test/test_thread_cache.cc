@@ -0,0 +1,151 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestThreadCache
+# include <boost/test/unit_test.hpp>
+# include <boost/filesystem.hpp>
+
+# include "test_common.hh"
+# include "db.hh"
+# include "thread_cache.hh"
+
+# include <notmuch.h>
+
+using namespace Astroid;
+
+BOOST_AUTO_TEST_SUITE(ThreadCacheTest)
+
+  BOOST_AUTO_TEST_CASE(save_and_load)
+  {
+    setup ();
+
+    Db db (Db::DbMode::DATABASE_READ_ONLY);
+
+    /* get a thread with all fields */
+    notmuch_query_t * q = notmuch_query_create (db.nm_db, "*");
+    notmuch_threads_t * threads;
+    notmuch_status_t st = notmuch_query_search_threads_st (q, &threads);
+
+    BOOST_REQUIRE (st == NOTMUCH_STATUS_SUCCESS);
+    BOOST_REQUIRE (notmuch_threads_valid (threads));
+
+    notmuch_thread_t * nm_thread = notmuch_threads_get (threads);
+    refptr<NotmuchThread> t (new NotmuchThread (nm_thread));
+    notmuch_thread_destroy (nm_thread);
+    notmuch_threads_destroy (threads);
+    notmuch_query_destroy (q);
+
+    std::string key = ThreadCache::query_key ("*", NOTMUCH_SORT_NEWEST_FIRST, db.excluded_tags);
+
+    {
+      ThreadCache tc (true);
+      BOOST_REQUIRE (tc.enabled);
+      tc.validate (&db);
+      tc.put (key, t);
+      tc.save ();
+    }
+
+    /* read back */
+    ThreadCache tc (true);
+    BOOST_REQUIRE (tc.enabled);
+    tc.validate (&db);
+
+    /* without details only the cheap fields are set */
+    refptr<NotmuchThread> b = tc.get (key, t->thread_id);
+
+    BOOST_REQUIRE (b);
+    BOOST_CHECK (!b->details_loaded);
+    BOOST_CHECK (b->subject.empty ());
+    BOOST_CHECK (b->tags == t->tags);
+
+    refptr<NotmuchThread> c = tc.get (key, t->thread_id, true);
+
+    BOOST_REQUIRE (c);
+    BOOST_CHECK (c->details_loaded);
+    BOOST_CHECK (c->subject == t->subject);
+    BOOST_CHECK (c->newest_date == t->newest_date);
+    BOOST_CHECK (c->oldest_date == t->oldest_date);
+    BOOST_CHECK (c->total_messages == t->total_messages);
+    BOOST_CHECK (c->unread == t->unread);
+    BOOST_CHECK (c->tags == t->tags);
+    BOOST_CHECK (c->authors == t->authors);
+
+    /* invalidated threads are not returned */
+    tc.invalidate (t->thread_id);
+    BOOST_CHECK (!tc.get (key, t->thread_id));
+
+    db.close ();
+
+    teardown ();
+  }
+
+  BOOST_AUTO_TEST_CASE(keyed_by_query)
+  {
+    setup ();
+
+    Db db (Db::DbMode::DATABASE_READ_ONLY);
+
+    /* the same thread through two queries matching different messages */
+    auto load = [&] (ustring query) {
+      notmuch_query_t * q = notmuch_query_create (db.nm_db, query.c_str ());
+      notmuch_query_set_sort (q, NOTMUCH_SORT_NEWEST_FIRST);
+      notmuch_threads_t * threads;
+      notmuch_status_t st = notmuch_query_search_threads_st (q, &threads);
+
+      BOOST_REQUIRE (st == NOTMUCH_STATUS_SUCCESS);
+      BOOST_REQUIRE (notmuch_threads_valid (threads));
+
+      notmuch_thread_t * nm_thread = notmuch_threads_get (threads);
+      refptr<NotmuchThread> t (new NotmuchThread (nm_thread));
+      notmuch_thread_destroy (nm_thread);
+      notmuch_threads_destroy (threads);
+      notmuch_query_destroy (q);
+
+      return t;
+    };
+
+    ustring q1 = "id:1255623468-sup-2284@yoom.home.cworth.org";
+    ustring q2 = "id:1256009934-sup-9323@yoom.home.cworth.org";
+
+    refptr<NotmuchThread> t1 = load (q1);
+    refptr<NotmuchThread> t2 = load (q2);
+
+    BOOST_REQUIRE (t1->thread_id == t2->thread_id);
+    BOOST_REQUIRE (t1->newest_date != t2->newest_date);
+    BOOST_REQUIRE (t1->subject != t2->subject);
+
+    std::string k1 = ThreadCache::query_key (q1, NOTMUCH_SORT_NEWEST_FIRST, db.excluded_tags);
+    std::string k2 = ThreadCache::query_key (q2, NOTMUCH_SORT_NEWEST_FIRST, db.excluded_tags);
+
+    ThreadCache tc (true);
+    BOOST_REQUIRE (tc.enabled);
+    tc.validate (&db);
+
+    tc.put (k1, t1);
+    BOOST_CHECK (!tc.get (k2, t1->thread_id));
+
+    tc.put (k2, t2);
+    tc.save ();
+
+    for (auto &p : { std::make_pair (k1, t1), std::make_pair (k2, t2) }) {
+      refptr<NotmuchThread> c = tc.get (p.first, p.second->thread_id, true);
+
+      BOOST_REQUIRE (c);
+      BOOST_CHECK (c->newest_date == p.second->newest_date);
+      BOOST_CHECK (c->oldest_date == p.second->oldest_date);
+      BOOST_CHECK (c->subject == p.second->subject);
+      BOOST_CHECK (c->authors == p.second->authors);
+    }
+
+    /* the sort order is part of the key */
+    BOOST_CHECK (!tc.get (ThreadCache::query_key (q1, NOTMUCH_SORT_OLDEST_FIRST, db.excluded_tags), t1->thread_id));
+
+    /* invalidating the thread drops it for all queries */
+    tc.invalidate (t1->thread_id);
+    BOOST_CHECK (!tc.get (k1, t1->thread_id));
+    BOOST_CHECK (!tc.get (k2, t2->thread_id));
+
+    db.close ();
+
+    teardown ();
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+# define BOOST_TEST_DYN_LINK
+# define BOOST_TEST_MODULE TestThumbnailCache
+# include <boost/test/unit_test.hpp>
+# include <boost/filesystem.hpp>
+
+# include "test_common.hh"
+# include "thumbnail_cache.hh"
+
+using namespace Astroid;
+
+BOOST_AUTO_TEST_SUITE(ThumbnailCacheTest)
+
+  BOOST_AUTO_TEST_CASE(put_and_evict)
+  {
+    setup ();
+
+    bfs::path dir = astroid->standard_paths ().cache_dir / bfs::path ("test-thumbnails");
+    bfs::remove_all (dir);
+
+    std::string png (400, 'x');
+
+    /* room for two thumbnails */
+    ThumbnailCache tc (dir, 1100);
+    BOOST_REQUIRE (tc.enabled);
+
+    ustring k1 = ThumbnailCache::make_key ("mid1@test", 1, 1234, 150);
+    ustring k2 = ThumbnailCache::make_key ("mid1@test", 2, 1234, 150);
+    ustring k3 = ThumbnailCache::make_key ("mid2@test", 1, 1234, 150);
+
+    BOOST_CHECK (k1 != k2);
+
+    bfs::path p;
+    BOOST_CHECK (!tc.get (k1, p));
+
+    BOOST_CHECK (tc.put (k1, png));
+    BOOST_CHECK (tc.get (k1, p));
+    BOOST_CHECK (bfs::file_size (p) == png.size ());
+
+    BOOST_CHECK (tc.put (k2, png));
+    BOOST_CHECK (tc.size () == 800);
+
+    /* k1 is used more recently than k2 */
+    BOOST_CHECK (tc.get (k2, p));
+    bfs::last_write_time (p, time (NULL) - 100);
+
+    /* the least recently used thumbnail is evicted */
+    BOOST_CHECK (tc.put (k3, png));
+    BOOST_CHECK (!tc.get (k2, p));
+    BOOST_CHECK (tc.get (k1, p));
+    BOOST_CHECK (tc.get (k3, p));
+    BOOST_CHECK (tc.size () == 800);
+
+    /* keys must be usable as file names */
+    BOOST_CHECK (!tc.put ("../foo", png));
+
+    bfs::remove_all (dir);
+
+    teardown ();
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
+